@@ -0,0 +1,199 @@
+#include "aggregate.h"
+#include "survival.h"
+#include "user_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Two-sided 95% quantile of the normal distribution */
+#define CONFIDENCE_Z 1.96
+
+void aggregates_init(Aggregates *agg) {
+    memset(agg, 0, sizeof(*agg));
+}
+
+void aggregates_free(Aggregates *agg) {
+    free(agg->rows);
+    free(agg->row_of_key);
+    aggregates_init(agg);
+}
+
+static int grow_rows(Aggregates *agg, int new_capacity) {
+    if (heap_frozen) return -1;
+    AggregateRow *rows = realloc(agg->rows, new_capacity * sizeof(AggregateRow));
+    if (!rows) return -1;
+    agg->rows = rows;
+    agg->capacity = new_capacity;
+    return 0;
+}
+
+static int grow_keys(Aggregates *agg, int new_capacity) {
+    if (heap_frozen) return -1;
+    int *row_of_key = realloc(agg->row_of_key, new_capacity * sizeof(int));
+    if (!row_of_key) return -1;
+    agg->row_of_key = row_of_key;
+    agg->key_capacity = new_capacity;
+    return 0;
+}
+
+int aggregates_reserve(Aggregates *agg, int commands) {
+    if (commands > agg->capacity && grow_rows(agg, commands) < 0) return -1;
+    if (commands > agg->key_capacity && grow_keys(agg, commands) < 0) return -1;
+    return 0;
+}
+
+/* Returns: the row for key, created on first use, or NULL */
+static AggregateRow* row_for(Aggregates *agg, int key) {
+    int row = agg->row_of_key[key];
+    if (row >= 0) return &agg->rows[row];
+
+    if (agg->count == agg->capacity &&
+        grow_rows(agg, agg->capacity ? agg->capacity * 2 : 64) < 0) {
+        return NULL;
+    }
+
+    agg->row_of_key[key] = agg->count;
+    AggregateRow *new_row = &agg->rows[agg->count++];
+    memset(new_row, 0, sizeof(*new_row));
+    new_row->key = key;
+    return new_row;
+}
+
+static int compare_cpu_desc(const void *a, const void *b) {
+    const AggregateRow *ra = a;
+    const AggregateRow *rb = b;
+    if (ra->cpu != rb->cpu) return ra->cpu < rb->cpu ? 1 : -1;
+    return ra->key - rb->key;
+}
+
+/* Most threads first, so the histogram reads top-down */
+static int compare_tasks_desc(const void *a, const void *b) {
+    const AggregateRow *ra = a;
+    const AggregateRow *rb = b;
+    if (ra->tasks != rb->tasks) return rb->tasks - ra->tasks;
+    return ra->key - rb->key;
+}
+
+static const InternTable* key_names(AggregateKey by) {
+    switch (by) {
+        case AGGREGATE_BY_USER: return &user_names;
+        case AGGREGATE_BY_WAIT: return &wait_channels;
+        default:                return &command_names;
+    }
+}
+
+/* Tasks whose uid was not collected count under "?"
+ * Returns: the key, -1 on allocation failure, -2 for a task that is left out
+ */
+static int task_key(const TaskInfo *task, AggregateKey by) {
+    switch (by) {
+        case AGGREGATE_BY_USER:
+            if (!(task->collected & FIELD_BIT(FIELD_UID))) return intern_string(&user_names, "?");
+            return user_name_id(task->uid);
+        case AGGREGATE_BY_WAIT:
+            return task->collected & FIELD_BIT(FIELD_WCHAN) ? task->wchan_id : -2;
+        default:
+            return task->command_id;
+    }
+}
+
+const char* aggregate_key_name(AggregateKey by, int key) {
+    return intern_lookup(key_names(by), key);
+}
+
+int aggregate_task_matches(AggregateKey by, int key, const TaskInfo *task) {
+    switch (by) {
+        case AGGREGATE_BY_USER:
+            return (task->collected & FIELD_BIT(FIELD_UID)) && user_name_id(task->uid) == key;
+        case AGGREGATE_BY_WAIT:
+            return (task->collected & FIELD_BIT(FIELD_WCHAN)) && task->wchan_id == key;
+        default:
+            return task->command_id == key;
+    }
+}
+
+int aggregate_tasks(Aggregates *agg, AggregateKey by, const Snapshot *snapshot,
+                    const Snapshot *prev, const IntMap *certain, double fraction) {
+    /* Keys are dense ids, so rows are found through a plain array */
+    const InternTable *names = key_names(by);
+    if (names->count > agg->key_capacity && grow_keys(agg, names->count) < 0) return -1;
+    memset(agg->row_of_key, 0xff, agg->key_capacity * sizeof(int));
+
+    agg->count = 0;
+    agg->certain_tasks = 0;
+    agg->sampled_tasks = 0;
+    agg->unsampled_tasks = 0;
+
+    int sampling = fraction < 1.0;
+    double variance_scale = (1.0 - fraction) / (fraction * fraction);
+    double total_variance = 0.0;
+
+    /* Row cpu_margin holds the variance until the end */
+    for (int i = 0; i < snapshot->count; i++) {
+        const TaskInfo *task = &snapshot->tasks[i];
+        if (task->exited) continue;
+
+        /* A uid carried over from before a passwd reload is new to the cache */
+        int key = task_key(task, by);
+        if (key == -2) continue;
+        if (key < 0) return -1;
+        if (key >= agg->key_capacity) {
+            int old_capacity = agg->key_capacity;
+            if (grow_keys(agg, names->count) < 0) return -1;
+            memset(agg->row_of_key + old_capacity, 0xff, (agg->key_capacity - old_capacity) * sizeof(int));
+        }
+        AggregateRow *row = row_for(agg, key);
+        if (!row) return -1;
+        row->tasks++;
+
+        int is_certain = !sampling || intmap_get(certain, task->tid) >= 0 ||
+                         !prev || snapshot_find_tid(prev, task->tid) < 0;
+        if (is_certain) {
+            row->cpu += task->cpu_percent;
+            agg->certain_tasks++;
+        } else if (task->sampled_ns[SOURCE_STAT] >= snapshot->taken_ns) {
+            double variance = variance_scale * task->cpu_percent * task->cpu_percent;
+            row->cpu += task->cpu_percent / fraction;
+            row->cpu_margin += variance;
+            row->sampled++;
+            total_variance += variance;
+            agg->sampled_tasks++;
+        } else {
+            agg->unsampled_tasks++;
+        }
+    }
+
+    agg->total_cpu = 0.0;
+    for (int i = 0; i < agg->count; i++) {
+        agg->rows[i].cpu_margin = CONFIDENCE_Z * sqrt(agg->rows[i].cpu_margin);
+        agg->total_cpu += agg->rows[i].cpu;
+    }
+    agg->total_margin = CONFIDENCE_Z * sqrt(total_variance);
+
+    qsort(agg->rows, agg->count, sizeof(AggregateRow),
+          by == AGGREGATE_BY_WAIT ? compare_tasks_desc : compare_cpu_desc);
+    return 0;
+}
+
+int find_top_contributors(const Snapshot *snapshot, int *tids, int k) {
+    if (k <= 0) return 0;
+    double cpu[k];
+    int found = 0;
+
+    /* Insertion into a small sorted array; k is a few dozen at most */
+    for (int i = 0; i < snapshot->count; i++) {
+        const TaskInfo *task = &snapshot->tasks[i];
+        if (task->cpu_percent <= 0.0 || task->exited) continue;
+        if (found == k && task->cpu_percent <= cpu[found - 1]) continue;
+
+        int pos = found < k ? found++ : k - 1;
+        while (pos > 0 && cpu[pos - 1] < task->cpu_percent) {
+            cpu[pos] = cpu[pos - 1];
+            tids[pos] = tids[pos - 1];
+            pos--;
+        }
+        cpu[pos] = task->cpu_percent;
+        tids[pos] = task->tid;
+    }
+    return found;
+}
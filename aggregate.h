@@ -0,0 +1,63 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "snapshot.h"
+
+/* ========== Per-Command, Per-User and Per-Wait-Channel Aggregates ========== */
+
+/* What the rows total over; all are interned, so keys are dense ids */
+typedef enum {
+    AGGREGATE_BY_COMMAND,  /* command_names ids */
+    AGGREGATE_BY_USER,     /* user_names ids */
+    AGGREGATE_BY_WAIT      /* wait_channels ids; only threads whose wchan was read */
+} AggregateKey;
+
+typedef struct {
+    int key;              /* Interned command or user name */
+    int tasks;            /* Exact: every task is enumerated each tick */
+    int sampled;          /* Tasks counted through the sample */
+    double cpu;           /* CPU%, estimated when sampling */
+    double cpu_margin;    /* Half-width of the 95% confidence interval; 0 = exact */
+} AggregateRow;
+
+typedef struct {
+    AggregateRow *rows;   /* Sorted by CPU%, highest first; by tasks for wait channels */
+    int count;
+    int capacity;
+    int *row_of_key;      /* key -> row, -1 = none yet */
+    int key_capacity;
+
+    double total_cpu;
+    double total_margin;
+    int certain_tasks;    /* Read for sure: priority set, top contributors, new */
+    int sampled_tasks;
+    int unsampled_tasks;
+} Aggregates;
+
+void aggregates_init(Aggregates *agg);
+void aggregates_free(Aggregates *agg);
+
+/* Room for this many distinct commands or users without growing. Returns: -1 on allocation failure */
+int aggregates_reserve(Aggregates *agg, int commands);
+
+/*
+ * Sum CPU% per command or per user over a snapshot collected with the given sample
+ * fraction. Tasks in certain, and tasks new since prev, were always read and
+ * count exactly; the other freshly read ones are a random sample taken with
+ * probability fraction and are scaled up by 1/fraction (Horvitz-Thompson).
+ * With fraction >= 1 every task counts exactly.
+ * Returns: -1 on allocation failure
+ */
+int aggregate_tasks(Aggregates *agg, AggregateKey by, const Snapshot *snapshot,
+                    const Snapshot *prev, const IntMap *certain, double fraction);
+
+/* Returns: the name a row is keyed on */
+const char* aggregate_key_name(AggregateKey by, int key);
+
+/* Returns: 1 if the task counts in the row for key */
+int aggregate_task_matches(AggregateKey by, int key, const TaskInfo *task);
+
+/* The k busiest tasks by CPU%, written to tids. Returns: how many were found */
+int find_top_contributors(const Snapshot *snapshot, int *tids, int k);
+
+#endif /* AGGREGATE_H */
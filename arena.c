@@ -0,0 +1,113 @@
+#include "arena.h"
+#include "survival.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Every allocation is aligned for the strictest scalar type we store */
+#define ARENA_ALIGN 16
+#define ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+#define BLOCK_HEADER ALIGN_UP(sizeof(ArenaBlock))
+
+static char* block_data(ArenaBlock *block) {
+    return (char*)block + BLOCK_HEADER;
+}
+
+static ArenaBlock* new_block(size_t size) {
+    if (heap_frozen) return NULL;
+    ArenaBlock *block = malloc(BLOCK_HEADER + size);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void arena_init(Arena *arena, size_t block_size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->block_size = ALIGN_UP(block_size);
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->first;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena, arena->block_size);
+}
+
+void arena_reset(Arena *arena) {
+    /* Later blocks are rewound lazily when allocation moves on to them */
+    arena->current = arena->first;
+    if (arena->current) arena->current->used = 0;
+    arena->used = 0;
+}
+
+/* Link a new block in after the current one, so it is the next to be used */
+static void insert_block(Arena *arena, ArenaBlock *block) {
+    if (arena->current) {
+        block->next = arena->current->next;
+        arena->current->next = block;
+    } else {
+        block->next = arena->first;
+        arena->first = block;
+    }
+    arena->reserved += block->size;
+}
+
+int arena_reserve(Arena *arena, size_t size) {
+    size = ALIGN_UP(size);
+
+    /* Blocks after the current one count as empty; they are rewound on use */
+    for (ArenaBlock *block = arena->current; block; block = block->next) {
+        size_t used = block == arena->current ? block->used : 0;
+        if (block->size - used >= size) return 0;
+    }
+
+    ArenaBlock *block = new_block(size > arena->block_size ? size : arena->block_size);
+    if (!block) return -1;
+    insert_block(arena, block);
+
+    /* A fresh arena starts allocating from its first block, as after a reset */
+    if (!arena->current) arena->current = arena->first;
+    return 0;
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    size = ALIGN_UP(size ? size : 1);
+
+    ArenaBlock *block = arena->current;
+    while (block && block->used + size > block->size) {
+        /* Move on to a block kept from before the last reset */
+        block = block->next;
+        if (block) block->used = 0;
+    }
+
+    if (!block) {
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = new_block(block_size);
+        if (!block) return NULL;
+
+        /* Append after the current block so the chain is reused in order */
+        insert_block(arena, block);
+    }
+
+    arena->current = block;
+    void *ptr = block_data(block) + block->used;
+    block->used += size;
+
+    arena->used += size;
+    if (arena->used > arena->high_water) arena->high_water = arena->used;
+    return ptr;
+}
+
+char* arena_strndup(Arena *arena, const char *str, size_t max_len) {
+    size_t len = strnlen(str, max_len);
+    char *copy = arena_alloc(arena, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
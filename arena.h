@@ -0,0 +1,47 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* ========== Bump-Pointer Arena ========== */
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    /* Data follows the header, suitably aligned */
+} ArenaBlock;
+
+/*
+ * Allocations are carved sequentially out of a chain of blocks and are
+ * never freed individually. arena_reset() rewinds to the first block in
+ * O(1) and keeps every block, so an arena that has reached its working
+ * size stops calling malloc altogether.
+ */
+typedef struct {
+    ArenaBlock *first;
+    ArenaBlock *current;
+    size_t block_size;    /* Minimum size of new blocks */
+    size_t used;          /* Bytes handed out since the last reset */
+    size_t reserved;      /* Bytes held in blocks */
+    size_t high_water;    /* Largest 'used' seen over the arena's lifetime */
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+void arena_free(Arena *arena);
+
+/* Forget all allocations; memory is kept for reuse */
+void arena_reset(Arena *arena);
+
+/* Make sure size bytes can be allocated without calling malloc, keeping the
+ * current allocations. Returns: -1 on allocation failure
+ */
+int arena_reserve(Arena *arena, size_t size);
+
+/* Returns: aligned memory valid until the next reset, or NULL */
+void* arena_alloc(Arena *arena, size_t size);
+
+/* Copy at most max_len bytes of str into the arena, NUL-terminated */
+char* arena_strndup(Arena *arena, const char *str, size_t max_len);
+
+#endif /* ARENA_H */
@@ -0,0 +1,177 @@
+/*
+ * bench_render - Compare the ncurses and ANSI renderers through a pty
+ *
+ * Each backend runs in a child whose terminal is the slave side of a
+ * pseudo-terminal; the parent reads the master side and counts every byte
+ * the backend sends. Frames are a synthetic task table in three patterns:
+ * nothing changes, a tenth of the CPU cells change, and the whole table
+ * scrolls by one row per frame.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+
+#include "render.h"
+#include "timing.h"
+
+#define BENCH_ROWS 50
+#define BENCH_COLS 160
+#define BENCH_FRAMES 300
+#define TASKS 100000
+#define CHANGE_FRACTION 0.10  /* Rows whose CPU cell changes per frame, in the update pattern */
+
+typedef enum {
+    PATTERN_STATIC,
+    PATTERN_UPDATE,
+    PATTERN_SCROLL,
+    PATTERN_COUNT
+} Pattern;
+
+static const char *pattern_names[PATTERN_COUNT] = {"static", "update", "scroll"};
+
+typedef struct {
+    uint64_t frame_ns;        /* Sum over frames, measured in the child */
+    unsigned long frames;
+} ChildResult;
+
+static double cpu[TASKS];
+
+/* One frame of a table like the task list, starting at row top */
+static void draw_frame(int top) {
+    render_erase();
+
+    render_attron(ATTR_PAIR(1) | ATTR_BOLD);
+    render_print(0, 0, "ProcessExplorerLite   Sort: CPU%% desc");
+    render_attroff(ATTR_PAIR(1) | ATTR_BOLD);
+    render_hline(1, 0, '-', BENCH_COLS);
+
+    render_attron(ATTR_PAIR(3) | ATTR_BOLD);
+    render_print(2, 2, "%-8s %-8s %-20s %-15s %6s %s", "PID", "TID", "Command", "State", "CPU%", "Command line");
+    render_attroff(ATTR_PAIR(3) | ATTR_BOLD);
+    render_hline(3, 0, '-', BENCH_COLS);
+
+    static int drawn_top = -1;
+    if (drawn_top >= 0) render_scroll(4, BENCH_ROWS - 1, top - drawn_top);
+    drawn_top = top;
+
+    for (int line = 0; line < BENCH_ROWS - 5; line++) {
+        int task = (top + line) % TASKS;
+        int selected = line == 10;
+        if (selected) {
+            render_attron(ATTR_PAIR(5) | ATTR_BOLD);
+            render_hline(4 + line, 0, ' ', BENCH_COLS);
+        }
+        render_print(4 + line, 2, "%-8d %-8d %-20s %-15s %6.1f /usr/bin/worker --id %d --queue jobs-%d",
+                     1000 + task, 1000 + task, "worker", task % 7 ? "Sleeping" : "Running",
+                     cpu[task], task, task % 16);
+        if (selected) render_attroff(ATTR_PAIR(5) | ATTR_BOLD);
+    }
+
+    render_attron(ATTR_PAIR(2));
+    render_print(BENCH_ROWS - 1, 0, "Keys: [Up/Down]Navigate | [q]uit");
+    render_attroff(ATTR_PAIR(2));
+    render_present();
+}
+
+static void run_child(RenderBackend backend, Pattern pattern, int result_fd) {
+    if (render_init(backend) < 0) _exit(1);
+    render_init_pair(1, COLOR_CYAN, COLOR_BLACK);
+    render_init_pair(2, COLOR_GREEN, COLOR_BLACK);
+    render_init_pair(3, COLOR_YELLOW, COLOR_BLACK);
+    render_init_pair(5, COLOR_BLACK, COLOR_WHITE);
+
+    ChildResult result = {0, 0};
+    srand(1);
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        if (pattern == PATTERN_UPDATE) {
+            for (int i = 0; i < BENCH_ROWS; i++) {
+                if (rand() < CHANGE_FRACTION * RAND_MAX) cpu[i] = (rand() % 1000) / 10.0;
+            }
+        }
+        draw_frame(pattern == PATTERN_SCROLL ? frame : 0);
+        result.frame_ns += render_stats()->last_frame_ns;
+        result.frames++;
+    }
+
+    render_end();
+    if (write(result_fd, &result, sizeof(result)) < 0) _exit(1);
+    _exit(0);
+}
+
+/* Returns: bytes the child wrote to the terminal, or -1 */
+static long run_backend(RenderBackend backend, Pattern pattern, ChildResult *result) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) return -1;
+    struct winsize ws = {BENCH_ROWS, BENCH_COLS, 0, 0};
+    ioctl(master, TIOCSWINSZ, &ws);
+
+    int result_pipe[2];
+    if (pipe(result_pipe) < 0) return -1;
+
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        setsid();
+        int slave = open(ptsname(master), O_RDWR);
+        if (slave < 0) _exit(1);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        close(master);
+        close(result_pipe[0]);
+        setenv("TERM", "xterm-256color", 0);
+        run_child(backend, pattern, result_pipe[1]);
+    }
+    close(result_pipe[1]);
+
+    /* Drain the master until the child has gone and its output is read */
+    long bytes = 0;
+    char buf[65536];
+    int exited = 0;
+    for (;;) {
+        fd_set readfds;
+        struct timeval timeout = {0, 20000};
+        FD_ZERO(&readfds);
+        FD_SET(master, &readfds);
+        if (select(master + 1, &readfds, NULL, NULL, &timeout) > 0) {
+            ssize_t n = read(master, buf, sizeof(buf));
+            if (n <= 0) break;
+            bytes += n;
+        } else if (exited) {
+            break;
+        }
+        if (!exited && waitpid(pid, NULL, WNOHANG) == pid) exited = 1;
+    }
+    if (!exited) waitpid(pid, NULL, 0);
+
+    int ok = read(result_pipe[0], result, sizeof(*result)) == (ssize_t)sizeof(*result);
+    close(result_pipe[0]);
+    close(master);
+    return ok ? bytes : -1;
+}
+
+int main(void) {
+    signal(SIGPIPE, SIG_IGN);
+    printf("%d frames of %dx%d through a pty\n\n", BENCH_FRAMES, BENCH_COLS, BENCH_ROWS);
+    printf("%-8s %-8s %12s %14s\n", "pattern", "backend", "ms/frame", "bytes/frame");
+
+    for (int pattern = 0; pattern < PATTERN_COUNT; pattern++) {
+        for (int backend = BACKEND_NCURSES; backend <= BACKEND_ANSI; backend++) {
+            ChildResult result;
+            long bytes = run_backend(backend, pattern, &result);
+            if (bytes < 0 || result.frames == 0) {
+                printf("%-8s %-8s %12s\n", pattern_names[pattern], backend_name(backend), "failed");
+                continue;
+            }
+            printf("%-8s %-8s %12.3f %14.0f\n", pattern_names[pattern], backend_name(backend),
+                   result.frame_ns / 1e6 / result.frames, (double)bytes / result.frames);
+        }
+    }
+    return 0;
+}
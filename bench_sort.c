@@ -0,0 +1,206 @@
+/*
+ * bench_sort - Compare full and adaptive re-sorting across refreshes
+ *
+ * Simulates a host where most tasks are idle and a fraction of them change
+ * their CPU usage between frames, while a few are born or die. Each frame
+ * is sorted three ways: qsort() with a comparator, a full radix sort, and
+ * the adaptive re-sort seeded with the previous frame's order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort.h"
+#include "timing.h"
+
+#define BENCH_ROWS 100000
+#define BENCH_FRAMES 50
+#define BIRTH_DEATH_RATE 0.001  /* Fraction of rows replaced per frame */
+#define BUSY_FRACTION 0.10      /* Fraction of rows with non-zero CPU */
+
+static double cpu[BENCH_ROWS];
+static int alive[BENCH_ROWS];
+static int prev_order[BENCH_ROWS];
+static SortPair pairs[BENCH_ROWS];
+static SortPair expected[BENCH_ROWS];
+
+static double random_unit(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static double random_cpu(void) {
+    return random_unit() < BUSY_FRACTION ? random_unit() * 100.0 : 0.0;
+}
+
+static int compare_pairs(const void *a, const void *b) {
+    const SortPair *pa = a;
+    const SortPair *pb = b;
+    if (pa->key != pb->key) return pa->key < pb->key ? -1 : 1;
+    return (int)pa->row - (int)pb->row;
+}
+
+/* Sort key for a row: descending CPU, the typical "top" ordering */
+static uint64_t row_key(int row) {
+    return ~sort_encode_double(cpu[row]);
+}
+
+/* Change churn of the rows' CPU values and replace a few rows outright */
+static void advance_frame(double churn) {
+    for (int i = 0; i < BENCH_ROWS; i++) {
+        if (random_unit() < churn) cpu[i] = random_cpu();
+        if (random_unit() < BIRTH_DEATH_RATE) {
+            alive[i] = !alive[i];
+            cpu[i] = random_cpu();
+        }
+    }
+}
+
+static int fill_pairs_by_row(void) {
+    int count = 0;
+    for (int i = 0; i < BENCH_ROWS; i++) {
+        if (!alive[i]) continue;
+        pairs[count].key = row_key(i);
+        pairs[count].row = i;
+        count++;
+    }
+    return count;
+}
+
+/* Previous order first, rows not in it appended, as the UI seeds its view */
+static int fill_pairs_from_previous(int prev_count) {
+    static unsigned char placed[BENCH_ROWS];
+    int count = 0;
+
+    memset(placed, 0, sizeof(placed));
+    for (int i = 0; i < prev_count; i++) {
+        int row = prev_order[i];
+        if (!alive[row]) continue;
+        placed[row] = 1;
+        pairs[count].key = row_key(row);
+        pairs[count].row = row;
+        count++;
+    }
+    for (int i = 0; i < BENCH_ROWS; i++) {
+        if (!alive[i] || placed[i]) continue;
+        pairs[count].key = row_key(i);
+        pairs[count].row = i;
+        count++;
+    }
+    return count;
+}
+
+/* The adaptive result must match a stable sort of the same input, ties included */
+static int same_order(const SortPair *a, const SortPair *b, int count) {
+    for (int i = 0; i < count; i++) {
+        if (a[i].key != b[i].key || a[i].row != b[i].row) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Equal keys split across the kept and displaced sets: in a sorted run,
+ * "50a, 20, 50b" sets 50a aside with the 20 while 50b stays kept, and the
+ * 20 lands among the kept 20s. Every tie must still come out in input order.
+ */
+static int check_ties(SortEngine *engine) {
+    int count = 256;
+    for (int i = 0; i < count; i++) {
+        pairs[i].key = i / 2;
+        pairs[i].row = i;
+    }
+    pairs[101].key = 20;
+    pairs[102].key = 50;
+
+    memcpy(expected, pairs, count * sizeof(SortPair));
+    sort_pairs(engine, expected, count);
+    sort_pairs_adaptive(engine, pairs, count);
+    return same_order(pairs, expected, count);
+}
+
+static void run_churn(SortEngine *engine, double churn) {
+    uint64_t qsort_ns = 0, radix_ns = 0, adaptive_ns = 0;
+    long displaced_total = 0;
+    int fallbacks = 0;
+    int prev_count = 0;
+
+    srand(42);
+    for (int i = 0; i < BENCH_ROWS; i++) {
+        alive[i] = 1;
+        cpu[i] = random_cpu();
+    }
+
+    for (int frame = 0; frame <= BENCH_FRAMES; frame++) {
+        if (frame > 0) advance_frame(churn);
+
+        int count = fill_pairs_by_row();
+        uint64_t start = monotonic_ns();
+        qsort(pairs, count, sizeof(SortPair), compare_pairs);
+        uint64_t qsort_time = monotonic_ns() - start;
+
+        count = fill_pairs_by_row();
+        start = monotonic_ns();
+        sort_pairs(engine, pairs, count);
+        uint64_t radix_time = monotonic_ns() - start;
+
+        count = fill_pairs_from_previous(prev_count);
+        memcpy(expected, pairs, count * sizeof(SortPair));
+        sort_pairs(engine, expected, count);
+        start = monotonic_ns();
+        sort_pairs_adaptive(engine, pairs, count);
+        uint64_t adaptive_time = monotonic_ns() - start;
+
+        if (!same_order(pairs, expected, count)) {
+            fprintf(stderr, "adaptive order differs from a stable sort at %.1f%% churn, frame %d\n",
+                    churn * 100.0, frame);
+            exit(1);
+        }
+
+        for (int i = 0; i < count; i++) prev_order[i] = pairs[i].row;
+        prev_count = count;
+
+        /* Frame 0 only warms up the buffers and the previous order */
+        if (frame == 0) continue;
+        qsort_ns += qsort_time;
+        radix_ns += radix_time;
+        adaptive_ns += adaptive_time;
+        displaced_total += engine->last_displaced;
+        fallbacks += engine->last_fallback;
+    }
+
+    printf("%7.1f%% %12.3f %12.3f %12.3f %12ld %10d\n",
+           churn * 100.0,
+           qsort_ns / 1e6 / BENCH_FRAMES,
+           radix_ns / 1e6 / BENCH_FRAMES,
+           adaptive_ns / 1e6 / BENCH_FRAMES,
+           displaced_total / BENCH_FRAMES,
+           fallbacks);
+}
+
+int main(void) {
+    const double churn_rates[] = {0.0, 0.001, 0.01, 0.05, 0.20, 0.50};
+    SortEngine engine;
+
+    sort_engine_init(&engine);
+
+    if (!check_ties(&engine)) {
+        fprintf(stderr, "adaptive sort reordered equal keys\n");
+        return 1;
+    }
+    if (!engine.last_displaced || engine.last_fallback) {
+        fprintf(stderr, "tie check did not exercise the merge\n");
+        return 1;
+    }
+
+    printf("%d rows, %d frames, %.1f%% births/deaths per frame (times in ms/frame)\n",
+           BENCH_ROWS, BENCH_FRAMES, BIRTH_DEATH_RATE * 100.0);
+    printf("%8s %12s %12s %12s %12s %10s\n",
+           "churn", "qsort", "radix", "adaptive", "displaced", "fallbacks");
+
+    for (size_t i = 0; i < sizeof(churn_rates) / sizeof(churn_rates[0]); i++) {
+        run_churn(&engine, churn_rates[i]);
+    }
+
+    sort_engine_free(&engine);
+    return 0;
+}
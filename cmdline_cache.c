@@ -0,0 +1,111 @@
+#include "cmdline_cache.h"
+#include "survival.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ========== Public Interface ========== */
+
+void cmdline_cache_init(CmdlineCache *cache) {
+    memset(cache, 0, sizeof(*cache));
+    keymap_init(&cache->index);
+    cache->generation = 1;
+}
+
+void cmdline_cache_free(CmdlineCache *cache) {
+    for (int i = 0; i < cache->count; i++) {
+        free(cache->entries[i].cmdline);
+    }
+    free(cache->entries);
+    keymap_free(&cache->index);
+    memset(cache, 0, sizeof(*cache));
+}
+
+const char* cmdline_cache_get(CmdlineCache *cache, int pid, unsigned long long starttime,
+                              int command_id) {
+    int index = keymap_get(&cache->index, pid, starttime);
+
+    if (index < 0 || cache->entries[index].command_id != command_id) {
+        cache->misses++;
+        return NULL;
+    }
+
+    CmdlineEntry *entry = &cache->entries[index];
+    entry->last_seen = cache->generation;
+    cache->hits++;
+    return entry->cmdline;
+}
+
+const char* cmdline_cache_put(CmdlineCache *cache, int pid, unsigned long long starttime,
+                              int command_id, const char *cmdline) {
+    if (heap_frozen) return NULL;  /* Callers keep their own copy */
+
+    size_t len = strlen(cmdline);
+    char *copy = malloc(len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, cmdline, len + 1);
+
+    /* Replace the line of a process that exec()ed */
+    int index = keymap_get(&cache->index, pid, starttime);
+    if (index >= 0) {
+        CmdlineEntry *entry = &cache->entries[index];
+        free(entry->cmdline);
+        entry->cmdline = copy;
+        entry->command_id = command_id;
+        entry->last_seen = cache->generation;
+        return copy;
+    }
+
+    if (cache->count == cache->capacity) {
+        int new_capacity = cache->capacity ? cache->capacity * 2 : 128;
+        CmdlineEntry *entries = realloc(cache->entries, new_capacity * sizeof(CmdlineEntry));
+        if (!entries) {
+            free(copy);
+            return NULL;
+        }
+        cache->entries = entries;
+        cache->capacity = new_capacity;
+    }
+
+    index = cache->count;
+    if (keymap_put(&cache->index, pid, starttime, index) < 0) {
+        free(copy);
+        return NULL;
+    }
+    cache->count++;
+    CmdlineEntry *entry = &cache->entries[index];
+    entry->pid = pid;
+    entry->starttime = starttime;
+    entry->command_id = command_id;
+    entry->cmdline = copy;
+    entry->last_seen = cache->generation;
+    return copy;
+}
+
+void cmdline_cache_touch(CmdlineCache *cache, int pid, unsigned long long starttime) {
+    int index = keymap_get(&cache->index, pid, starttime);
+    if (index >= 0) cache->entries[index].last_seen = cache->generation;
+}
+
+void cmdline_cache_sweep(CmdlineCache *cache, uint32_t max_idle) {
+    int kept = 0;
+
+    for (int i = 0; i < cache->count; i++) {
+        CmdlineEntry *entry = &cache->entries[i];
+        if (cache->generation - entry->last_seen < max_idle) {
+            cache->entries[kept++] = *entry;
+        } else {
+            free(entry->cmdline);
+            cache->evictions++;
+        }
+    }
+
+    /* Survivors moved down; index them where they are now */
+    if (kept != cache->count) {
+        cache->count = kept;
+        keymap_clear(&cache->index);
+        for (int i = 0; i < kept; i++) {
+            keymap_put(&cache->index, cache->entries[i].pid, cache->entries[i].starttime, i);
+        }
+    }
+    cache->generation++;
+}
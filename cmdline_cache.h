@@ -0,0 +1,57 @@
+#ifndef CMDLINE_CACHE_H
+#define CMDLINE_CACHE_H
+
+#include <stdint.h>
+#include "keymap.h"
+
+/* ========== Command Line Cache ========== */
+
+/*
+ * A process's command line is read once per process lifetime. Entries are
+ * keyed by (pid, starttime), so a recycled pid never inherits the command
+ * line of the process that used it before. exec() keeps both, so the entry
+ * also remembers the command it was read under and goes stale if that changes.
+ */
+typedef struct {
+    int pid;
+    unsigned long long starttime;
+    int command_id;            /* Interned command when the line was read */
+    char *cmdline;
+    uint32_t last_seen;        /* Sweep generation that last looked this up */
+} CmdlineEntry;
+
+typedef struct {
+    CmdlineEntry *entries;     /* Dense array, compacted by the sweep */
+    int count;
+    int capacity;
+    KeyMap index;              /* (pid, starttime) -> entry */
+    uint32_t generation;
+
+    /* Statistics */
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} CmdlineCache;
+
+void cmdline_cache_init(CmdlineCache *cache);
+void cmdline_cache_free(CmdlineCache *cache);
+
+/* Returns: the cached command line, or NULL if this process has not been read
+ * yet or has exec()ed since
+ */
+const char* cmdline_cache_get(CmdlineCache *cache, int pid, unsigned long long starttime,
+                              int command_id);
+
+/* Store a freshly read command line. Returns: the cached copy, or NULL */
+const char* cmdline_cache_put(CmdlineCache *cache, int pid, unsigned long long starttime,
+                              int command_id, const char *cmdline);
+
+/* Keep a live process's line through the next sweep, without looking it up */
+void cmdline_cache_touch(CmdlineCache *cache, int pid, unsigned long long starttime);
+
+/* Evict every process neither looked up nor touched in the last max_idle
+ * sweeps (it has exited); max_idle is at least 1
+ */
+void cmdline_cache_sweep(CmdlineCache *cache, uint32_t max_idle);
+
+#endif /* CMDLINE_CACHE_H */
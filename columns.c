@@ -0,0 +1,158 @@
+#include "columns.h"
+#include <strings.h>
+
+/* Which file each field is parsed from */
+static const ProcSource field_sources[FIELD_COUNT] = {
+    [FIELD_IDENTITY] = SOURCE_STAT,
+    [FIELD_UID]      = SOURCE_STAT,
+    [FIELD_COMMAND]  = SOURCE_STAT,
+    [FIELD_STATE]    = SOURCE_STAT,
+    [FIELD_CPU_TIME] = SOURCE_STAT,
+    [FIELD_MEMORY]   = SOURCE_STATM,
+    [FIELD_IO_BYTES] = SOURCE_IO,
+    [FIELD_CMDLINE]  = SOURCE_CMDLINE,
+    [FIELD_WCHAN]    = SOURCE_WCHAN,
+    [FIELD_FDS]      = SOURCE_FD,
+};
+
+const int tier_periods[TIER_COUNT] = {
+    [TIER_FAST]   = 1,
+    [TIER_MEDIUM] = 5,
+    [TIER_SLOW]   = 30,
+};
+
+#define COLUMN_DEF(id, name, title, width, right_align, sortable, group, field, visible, tier, kind, value) \
+    [id] = {name, title, width, right_align, sortable, group, FIELD_BIT(field), visible, tier},
+
+ColumnDef columns[COLUMN_COUNT] = {
+    COLUMN_TABLE(COLUMN_DEF)
+    COLUMN_TABLE_TAIL(COLUMN_DEF)
+};
+
+PluginValueType plugin_value_types[MAX_PLUGIN_COLUMNS];
+
+/* Add a field to the plan, read at least as often as tier asks */
+static void plan_field(CollectPlan *plan, TaskField field, SampleTier tier) {
+    ProcSource source = field_sources[field];
+    int period = tier_periods[tier];
+
+    plan->fields |= FIELD_BIT(field);
+    if (!(plan->sources & SOURCE_BIT(source)) || period < plan->periods[source]) {
+        plan->periods[source] = period;
+    }
+    plan->sources |= SOURCE_BIT(source);
+}
+
+void plan_add_column(CollectPlan *plan, ColumnId column) {
+    for (int field = 0; field < FIELD_COUNT; field++) {
+        if (columns[column].fields & FIELD_BIT(field)) {
+            plan_field(plan, field, columns[column].tier);
+        }
+    }
+}
+
+CollectPlan plan_collection(ColumnId sort_column, int filter_active) {
+    CollectPlan plan = {0, 0, {0}};
+    plan_field(&plan, FIELD_IDENTITY, TIER_FAST);
+
+    for (int i = 0; i < COLUMN_COUNT; i++) {
+        if (columns[i].visible) plan_add_column(&plan, i);
+    }
+    plan_add_column(&plan, sort_column);
+
+    /* The filter matches against the command and the full command line */
+    if (filter_active) {
+        plan_add_column(&plan, COL_COMMAND);
+        plan_add_column(&plan, COL_CMDLINE);
+    }
+    return plan;
+}
+
+unsigned source_fields(ProcSource source) {
+    unsigned fields = 0;
+    for (int field = 0; field < FIELD_COUNT; field++) {
+        if (field_sources[field] == source) fields |= FIELD_BIT(field);
+    }
+    return fields;
+}
+
+ProcSource field_source(TaskField field) {
+    return field_sources[field];
+}
+
+int add_plugin_column(const char *name, const char *title, int width, PluginValueType type) {
+    for (int c = COL_PLUGIN_FIRST; c <= COL_PLUGIN_LAST; c++) {
+        if (columns[c].name) continue;
+
+        /* Values come from the plugin, not from /proc, so nothing is planned */
+        ColumnDef def = {name, title, width, type == PLUGIN_NUMBER, 1, GROUP_BASIC, 0, 1, TIER_FAST};
+        columns[c] = def;
+        plugin_value_types[c - COL_PLUGIN_FIRST] = type;
+        return c;
+    }
+    return -1;
+}
+
+int set_column_tier(const char *column, const char *tier) {
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        if (!columns[c].name || strcasecmp(columns[c].name, column) != 0) continue;
+
+        for (int t = 0; t < TIER_COUNT; t++) {
+            if (strcasecmp(tier_name(t), tier) == 0) {
+                columns[c].tier = t;
+                return 0;
+            }
+        }
+        return -1;
+    }
+    return -1;
+}
+
+void toggle_column_group(ColumnGroup group) {
+    int show = 1;
+
+    /* If any column of the group is showing, hide them all */
+    for (int i = 0; i < COLUMN_COUNT; i++) {
+        if (columns[i].group == group && columns[i].visible) show = 0;
+    }
+    for (int i = 0; i < COLUMN_COUNT; i++) {
+        if (columns[i].group == group && columns[i].name) columns[i].visible = show;
+    }
+}
+
+const char* source_name(ProcSource source) {
+    switch (source) {
+        case SOURCE_STAT:    return "stat";
+        case SOURCE_STATM:   return "statm";
+        case SOURCE_IO:      return "io";
+        case SOURCE_CMDLINE: return "cmdline";
+        case SOURCE_WCHAN:   return "wchan";
+        case SOURCE_FD:      return "fd";
+        default:             return "?";
+    }
+}
+
+const char* tier_name(SampleTier tier) {
+    switch (tier) {
+        case TIER_FAST:   return "fast";
+        case TIER_MEDIUM: return "medium";
+        case TIER_SLOW:   return "slow";
+        default:          return "?";
+    }
+}
+
+const char* field_name(TaskField field) {
+    switch (field) {
+        case FIELD_IDENTITY: return "identity";
+        case FIELD_UID:      return "uid";
+        case FIELD_COMMAND:  return "command";
+        case FIELD_STATE:    return "state";
+        case FIELD_CPU_TIME: return "cpu";
+        case FIELD_MEMORY:   return "memory";
+        case FIELD_IO_BYTES: return "io";
+        case FIELD_CMDLINE:  return "cmdline";
+        case FIELD_WCHAN:    return "wchan";
+        case FIELD_FDS:      return "fds";
+        default:             return "?";
+    }
+}
@@ -0,0 +1,188 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include "plugin_api.h"
+
+/* ========== Data Sources ========== */
+
+/* Per-task files the collector can read */
+typedef enum {
+    SOURCE_STAT,      /* /proc/[pid]/task/[tid]/stat */
+    SOURCE_STATM,     /* /proc/[pid]/task/[tid]/statm */
+    SOURCE_IO,        /* /proc/[pid]/task/[tid]/io */
+    SOURCE_CMDLINE,   /* /proc/[pid]/cmdline, once per process lifetime */
+    SOURCE_WCHAN,     /* /proc/[pid]/task/[tid]/wchan, for blocked or watched threads only */
+    SOURCE_FD,        /* /proc/[pid]/fd and /proc/[pid]/limits, once per process */
+    SOURCE_COUNT
+} ProcSource;
+
+/* Fields a column can need; each one comes from exactly one source */
+typedef enum {
+    FIELD_IDENTITY,   /* pid, tid, starttime */
+    FIELD_UID,        /* Owner of the /proc entry, read alongside stat */
+    FIELD_COMMAND,
+    FIELD_STATE,
+    FIELD_CPU_TIME,   /* utime + stime */
+    FIELD_MEMORY,     /* size + resident */
+    FIELD_IO_BYTES,   /* read_bytes + write_bytes */
+    FIELD_CMDLINE,
+    FIELD_WCHAN,      /* Kernel function a thread sleeps in */
+    FIELD_FDS,        /* Open descriptors and their soft limit */
+    FIELD_COUNT
+} TaskField;
+
+#define SOURCE_BIT(source) (1u << (source))
+#define FIELD_BIT(field) (1u << (field))
+
+/* ========== Sampling Tiers ========== */
+
+/*
+ * Cheap fields are read every tick; expensive, slow-changing ones every
+ * few ticks. Each task reads a tiered file on its own slot of the tier's
+ * period, so the cost is spread evenly instead of spiking on one tick.
+ */
+typedef enum {
+    TIER_FAST,
+    TIER_MEDIUM,
+    TIER_SLOW,
+    TIER_COUNT
+} SampleTier;
+
+/* Ticks between two reads of the same task */
+extern const int tier_periods[TIER_COUNT];
+
+/* ========== Column Registry ========== */
+
+#define MAX_PLUGIN_COLUMNS 4
+
+/*
+ * Every built-in column, in display order. The table is expanded wherever a
+ * per-column piece of code is needed: the ColumnId enum and ColumnDef table
+ * here, the sort key loops in sort.c, the formatters in task_data.c and the
+ * numeric accessors in diff.c. Each expansion is a separate function per
+ * column with the field access inlined, so no hot loop switches on the
+ * column, and a new column is one line here.
+ *
+ *   X(id, name, title, width, right_align, sortable, group, field, visible, tier, kind, value)
+ *
+ * kind picks how value sorts and prints:
+ *   INT       signed integer
+ *   PERCENT   double, one decimal
+ *   BYTES     byte count (uint64_t)
+ *   BYTE_RATE bytes per second (double)
+ *   GROWTH    signed change per hour (double), shown with its sign
+ *   USER      interned user name id, sorted by name
+ *   COMMAND   interned command id, sorted by name
+ *   STATE     state letter, shown as a word
+ *   WAIT      interned wait channel id, sorted by name
+ *   TEXT      string, sorted by its first eight bytes
+ * value is an expression over `const TaskInfo *task`, parenthesised if it
+ * has a comma. width 0 takes the rest
+ * of the row, so that column belongs in COLUMN_TABLE_TAIL, after the plugin
+ * slots.
+ */
+#define COLUMN_TABLE(X) \
+    X(COL_PID,      "pid",     "PID",      8,  0, 1, GROUP_BASIC,  FIELD_IDENTITY, 1, TIER_FAST,   INT,       task->pid) \
+    X(COL_TID,      "tid",     "TID",      8,  0, 1, GROUP_BASIC,  FIELD_IDENTITY, 1, TIER_FAST,   INT,       task->tid) \
+    X(COL_USER,     "user",    "User",     10, 0, 1, GROUP_BASIC,  FIELD_UID,      1, TIER_FAST,   USER,      user_name_id(task->uid)) \
+    X(COL_COMMAND,  "command", "Command",  20, 0, 1, GROUP_BASIC,  FIELD_COMMAND,  1, TIER_FAST,   COMMAND,   task->command_id) \
+    X(COL_STATE,    "state",   "State",    12, 0, 1, GROUP_BASIC,  FIELD_STATE,    1, TIER_FAST,   STATE,     task->state) \
+    X(COL_CPU,      "cpu",     "CPU%",     6,  1, 1, GROUP_BASIC,  FIELD_CPU_TIME, 1, TIER_FAST,   PERCENT,   task->cpu_percent) \
+    X(COL_VIRT,     "virt",    "VIRT",     7,  1, 1, GROUP_MEMORY, FIELD_MEMORY,   1, TIER_MEDIUM, BYTES,     task->vm_size) \
+    X(COL_RSS,      "rss",     "RSS",      7,  1, 1, GROUP_MEMORY, FIELD_MEMORY,   1, TIER_MEDIUM, BYTES,     task->rss) \
+    X(COL_IO_READ,  "read",    "READ/s",   8,  1, 1, GROUP_IO,     FIELD_IO_BYTES, 0, TIER_MEDIUM, BYTE_RATE, task->io_read_rate) \
+    X(COL_IO_WRITE, "write",   "WRITE/s",  8,  1, 1, GROUP_IO,     FIELD_IO_BYTES, 0, TIER_MEDIUM, BYTE_RATE, task->io_write_rate) \
+    X(COL_RUN_PCT,  "run",     "%R",       5,  1, 1, GROUP_STATE,  FIELD_STATE,    0, TIER_FAST,   PERCENT,   (state_percent(task, STATE_RUNNING))) \
+    X(COL_DISK_PCT, "disk",    "%D",       5,  1, 1, GROUP_STATE,  FIELD_STATE,    0, TIER_FAST,   PERCENT,   (state_percent(task, STATE_DISK))) \
+    X(COL_STATE_CHANGES, "changes", "Trans", 6, 1, 1, GROUP_STATE, FIELD_STATE,    0, TIER_FAST,   INT,       (int)task->state_changes) \
+    X(COL_WCHAN,    "wchan",   "Wait channel", 20, 0, 1, GROUP_STATE, FIELD_WCHAN, 0, TIER_FAST,   WAIT,      task->wchan_id) \
+    X(COL_FDS,      "fds",     "FDs",      6,  1, 1, GROUP_FDS,    FIELD_FDS,      0, TIER_SLOW,   INT,       task->fd_count) \
+    X(COL_FD_RATE,  "fdrate",  "FD/h",     7,  1, 1, GROUP_FDS,    FIELD_FDS,      0, TIER_SLOW,   GROWTH,    task->fd_rate) \
+    X(COL_FD_LIMIT, "fdlimit", "FD%",      5,  1, 1, GROUP_FDS,    FIELD_FDS,      0, TIER_SLOW,   PERCENT,   (fd_limit_percent(task)))
+
+#define COLUMN_TABLE_TAIL(X) \
+    X(COL_CMDLINE,  "cmdline", "Command Line", 0, 0, 0, GROUP_BASIC, FIELD_CMDLINE, 1, TIER_SLOW,  TEXT,      task->cmdline)
+
+#define COLUMN_ENUM(id, ...) id,
+
+typedef enum {
+    COLUMN_TABLE(COLUMN_ENUM)
+    COL_PLUGIN_FIRST,   /* Slots for plugin columns; unclaimed ones have no name */
+    COL_PLUGIN_LAST = COL_PLUGIN_FIRST + MAX_PLUGIN_COLUMNS - 1,
+    COLUMN_TABLE_TAIL(COLUMN_ENUM)
+    COLUMN_COUNT
+} ColumnId;
+
+/* Columns toggled together from the keyboard */
+typedef enum {
+    GROUP_BASIC,
+    GROUP_MEMORY,
+    GROUP_IO,
+    GROUP_STATE,      /* Time in state over the window */
+    GROUP_FDS         /* Open descriptors, their growth and the limit */
+} ColumnGroup;
+
+typedef struct {
+    const char *name;     /* Short name for command-line options */
+    const char *title;
+    int width;            /* 0 = take the rest of the row (last column only) */
+    int right_align;      /* Numbers line up on the right */
+    int sortable;
+    ColumnGroup group;
+    unsigned fields;      /* FIELD_BIT() mask of what the column displays */
+    int visible;
+    SampleTier tier;
+} ColumnDef;
+
+extern ColumnDef columns[COLUMN_COUNT];
+
+/* Value type of each plugin column slot */
+extern PluginValueType plugin_value_types[MAX_PLUGIN_COLUMNS];
+
+static inline int is_plugin_column(ColumnId column) {
+    return column >= COL_PLUGIN_FIRST && column <= COL_PLUGIN_LAST;
+}
+
+/* What the collector reads this tick */
+typedef struct {
+    unsigned fields;      /* FIELD_BIT() mask */
+    unsigned sources;     /* SOURCE_BIT() mask */
+    int periods[SOURCE_COUNT];  /* Ticks between reads of each planned source */
+} CollectPlan;
+
+/* ========== Planner ========== */
+
+/*
+ * Minimal set of fields and files needed for the visible columns, the sort
+ * column and the active filter. Identity and the stat file are always in
+ * the plan since every task is found and named through stat. A source shared
+ * by several columns is read at the fastest of their tiers.
+ */
+CollectPlan plan_collection(ColumnId sort_column, int filter_active);
+
+/* Add what a column needs to a plan, e.g. for a view that does not show it */
+void plan_add_column(CollectPlan *plan, ColumnId column);
+
+/* Claim a plugin column slot; the strings must outlive the program's use of
+ * them. Returns: the column, or -1 if every slot is taken
+ */
+int add_plugin_column(const char *name, const char *title, int width, PluginValueType type);
+
+/* Show or hide every column in a group */
+void toggle_column_group(ColumnGroup group);
+
+/* Set a column's tier by names, e.g. ("rss", "slow"). Returns: -1 if either is unknown */
+int set_column_tier(const char *column, const char *tier);
+
+/* FIELD_BIT() mask of the fields parsed from one source */
+unsigned source_fields(ProcSource source);
+
+/* The file a field is parsed from */
+ProcSource field_source(TaskField field);
+
+/* Short names for the debug panel */
+const char* source_name(ProcSource source);
+const char* field_name(TaskField field);
+const char* tier_name(SampleTier tier);
+
+#endif /* COLUMNS_H */
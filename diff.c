@@ -0,0 +1,280 @@
+#include "diff.h"
+#include "survival.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ========== Buffers ========== */
+
+void diff_engine_init(DiffEngine *engine) {
+    memset(engine, 0, sizeof(*engine));
+    sort_engine_init(&engine->sorter);
+}
+
+void diff_engine_free(DiffEngine *engine) {
+    free(engine->order);
+    free(engine->prev_order);
+    free(engine->events);
+    sort_engine_free(&engine->sorter);
+    memset(engine, 0, sizeof(*engine));
+}
+
+static int grow_orders(DiffEngine *engine, int count) {
+    if (count <= engine->order_capacity) return 0;
+    if (heap_frozen) return -1;
+
+    int new_capacity = engine->order_capacity ? engine->order_capacity : 1024;
+    while (new_capacity < count) new_capacity *= 2;
+
+    SortPair *order = realloc(engine->order, new_capacity * sizeof(SortPair));
+    if (!order) return -1;
+    engine->order = order;
+
+    SortPair *prev_order = realloc(engine->prev_order, new_capacity * sizeof(SortPair));
+    if (!prev_order) return -1;
+    engine->prev_order = prev_order;
+
+    engine->order_capacity = new_capacity;
+    return 0;
+}
+
+static int grow_events(DiffEngine *engine, int count) {
+    if (count <= engine->event_capacity) return 0;
+    if (heap_frozen) return -1;
+
+    int new_capacity = engine->event_capacity ? engine->event_capacity : 256;
+    while (new_capacity < count) new_capacity *= 2;
+
+    ChangeEvent *events = realloc(engine->events, new_capacity * sizeof(ChangeEvent));
+    if (!events) return -1;
+    engine->events = events;
+    engine->event_capacity = new_capacity;
+    return 0;
+}
+
+int diff_engine_reserve(DiffEngine *engine, int tasks) {
+    if (grow_orders(engine, tasks) < 0 || grow_events(engine, tasks) < 0) return -1;
+    return sort_engine_reserve(&engine->sorter, tasks);
+}
+
+int diff_add_threshold(DiffEngine *engine, ColumnId column, double limit) {
+    if (engine->threshold_count == DIFF_MAX_THRESHOLDS) return -1;
+    engine->thresholds[engine->threshold_count].column = column;
+    engine->thresholds[engine->threshold_count].limit = limit;
+    engine->threshold_count++;
+    return 0;
+}
+
+int diff_subscribe(DiffEngine *engine, unsigned kinds, ChangeHandler handler, void *context) {
+    if (engine->subscriber_count == DIFF_MAX_SUBSCRIBERS) return -1;
+    Subscriber *subscriber = &engine->subscribers[engine->subscriber_count++];
+    subscriber->kinds = kinds;
+    subscriber->handler = handler;
+    subscriber->context = context;
+    return 0;
+}
+
+/* ========== Ordering ========== */
+
+/*
+ * Live rows of a snapshot in (pid, tid) order. /proc lists processes by pid
+ * and threads by tid, so this is normally one pass that finds them sorted.
+ * Returns: number of rows, or -1 if sorting needed memory it could not get
+ */
+static int order_rows(DiffEngine *engine, const Snapshot *snapshot, SortPair *order) {
+    int count = 0;
+    int sorted = 1;
+    for (int row = 0; row < snapshot->count; row++) {
+        const TaskInfo *task = &snapshot->tasks[row];
+        if (task->exited) continue;
+
+        uint64_t key = (uint64_t)(uint32_t)task->pid << 32 | (uint32_t)task->tid;
+        if (count > 0 && key < order[count - 1].key) sorted = 0;
+        order[count].key = key;
+        order[count].row = row;
+        count++;
+    }
+
+    engine->last_sorted = !sorted;
+    if (!sorted && sort_pairs(&engine->sorter, order, count) < 0) return -1;
+    return count;
+}
+
+/* ========== Diff ========== */
+
+/* Numeric value of each column from the column table; 0 for names and text */
+#define NUMBER_INT(value)       (double)(value)
+#define NUMBER_PERCENT(value)   (double)(value)
+#define NUMBER_BYTES(value)     (double)(value)
+#define NUMBER_BYTE_RATE(value) (double)(value)
+#define NUMBER_GROWTH(value)    (double)(value)
+#define NUMBER_USER(value)      ((void)sizeof(value), 0.0)
+#define NUMBER_COMMAND(value)   ((void)sizeof(value), 0.0)
+#define NUMBER_STATE(value)     ((void)sizeof(value), 0.0)
+#define NUMBER_TEXT(value)      ((void)sizeof(value), 0.0)
+#define NUMBER_WAIT(value)      ((void)sizeof(value), 0.0)
+
+#define COLUMN_NUMBER(id, name, title, width, right_align, sortable, group, field, visible, tier, kind, value) \
+    static double number_##id(const TaskInfo *task) { \
+        (void)task; \
+        return NUMBER_##kind(value); \
+    }
+
+COLUMN_TABLE(COLUMN_NUMBER)
+COLUMN_TABLE_TAIL(COLUMN_NUMBER)
+
+typedef double (*NumberFunction)(const TaskInfo *task);
+
+#define COLUMN_NUMBER_ENTRY(id, ...) [id] = number_##id,
+
+static const NumberFunction column_numbers[COLUMN_COUNT] = {
+    COLUMN_TABLE(COLUMN_NUMBER_ENTRY)
+    COLUMN_TABLE_TAIL(COLUMN_NUMBER_ENTRY)
+};
+
+static double plugin_number(const TaskInfo *task, ColumnId column) {
+    if (plugin_value_types[column - COL_PLUGIN_FIRST] != PLUGIN_NUMBER) return 0.0;
+    return task->plugin_values[column - COL_PLUGIN_FIRST].number;
+}
+
+static double column_value(const TaskInfo *task, ColumnId column) {
+    if (is_plugin_column(column)) return plugin_number(task, column);
+    return column_numbers[column](task);
+}
+
+/* Returns: the appended event, or NULL on allocation failure */
+static ChangeEvent* emit(DiffEngine *engine, ChangeKind kind, const TaskInfo *task, int row) {
+    if (engine->event_count == engine->event_capacity &&
+        grow_events(engine, engine->event_count + 1) < 0) {
+        return NULL;
+    }
+
+    ChangeEvent *event = &engine->events[engine->event_count++];
+    event->kind = kind;
+    event->pid = task->pid;
+    event->tid = task->tid;
+    event->row = row;
+    engine->counts[kind]++;
+    return event;
+}
+
+/* Everything that can change on a task that lived through the tick */
+static int compare_task(DiffEngine *engine, const TaskInfo *old, const TaskInfo *task, int row) {
+    ChangeEvent *event;
+
+    if (old->state != task->state) {
+        if (!(event = emit(engine, EVENT_STATE, task, row))) return -1;
+        event->change.state.from = old->state;
+        event->change.state.to = task->state;
+    }
+    if (old->command_id != task->command_id) {
+        if (!(event = emit(engine, EVENT_COMMAND, task, row))) return -1;
+        event->change.command.from = old->command_id;
+        event->change.command.to = task->command_id;
+    }
+
+    /* A value must have been collected on both sides to have crossed */
+    for (int i = 0; i < engine->threshold_count; i++) {
+        const Threshold *threshold = &engine->thresholds[i];
+        unsigned fields = columns[threshold->column].fields;
+        if ((old->collected & task->collected & fields) != fields) continue;
+
+        int was_over = column_value(old, threshold->column) >= threshold->limit;
+        int is_over = column_value(task, threshold->column) >= threshold->limit;
+        if (was_over == is_over) continue;
+
+        if (!(event = emit(engine, EVENT_THRESHOLD, task, row))) return -1;
+        event->change.threshold.index = i;
+        event->change.threshold.rising = is_over;
+    }
+    return 0;
+}
+
+static int merge(DiffEngine *engine, const Snapshot *prev, int prev_count,
+                 const Snapshot *next, int next_count) {
+    const SortPair *a = engine->prev_order;
+    const SortPair *b = engine->order;
+    int i = 0;
+    int j = 0;
+
+    while (i < prev_count || j < next_count) {
+        if (j == next_count || (i < prev_count && a[i].key < b[j].key)) {
+            if (!emit(engine, EVENT_DIED, &prev->tasks[a[i].row], a[i].row)) return -1;
+            i++;
+        } else if (i == prev_count || b[j].key < a[i].key) {
+            if (!emit(engine, EVENT_BORN, &next->tasks[b[j].row], b[j].row)) return -1;
+            j++;
+        } else {
+            const TaskInfo *old = &prev->tasks[a[i].row];
+            const TaskInfo *task = &next->tasks[b[j].row];
+
+            /* Same tid, different start time: the tid was reused */
+            if (old->starttime != task->starttime) {
+                if (!emit(engine, EVENT_DIED, old, a[i].row) ||
+                    !emit(engine, EVENT_BORN, task, b[j].row)) return -1;
+            } else if (compare_task(engine, old, task, b[j].row) < 0) {
+                return -1;
+            }
+            i++;
+            j++;
+        }
+    }
+    return 0;
+}
+
+int diff_snapshots(DiffEngine *engine, const Snapshot *prev, const Snapshot *next) {
+    uint64_t start = monotonic_ns();
+    engine->event_count = 0;
+    memset(engine->counts, 0, sizeof(engine->counts));
+
+    int capacity = next->count;
+    if (prev && prev->count > capacity) capacity = prev->count;
+    if (grow_orders(engine, capacity) < 0) return -1;
+
+    /* The previous diff already ordered prev, unless it was a different one */
+    int prev_count = 0;
+    if (prev) {
+        if (engine->ordered == prev && engine->ordered_taken_ns == prev->taken_ns) {
+            prev_count = engine->ordered_count;
+        } else {
+            prev_count = order_rows(engine, prev, engine->prev_order);
+            if (prev_count < 0) return -1;
+        }
+    }
+
+    int next_count = order_rows(engine, next, engine->order);
+    if (next_count < 0) return -1;
+
+    if (prev && merge(engine, prev, prev_count, next, next_count) < 0) return -1;
+
+    /* next is the next diff's prev */
+    SortPair *swap = engine->prev_order;
+    engine->prev_order = engine->order;
+    engine->order = swap;
+    engine->ordered = next;
+    engine->ordered_taken_ns = next->taken_ns;
+    engine->ordered_count = next_count;
+
+    for (int s = 0; s < engine->subscriber_count; s++) {
+        const Subscriber *subscriber = &engine->subscribers[s];
+        for (int e = 0; e < engine->event_count; e++) {
+            if (subscriber->kinds & EVENT_BIT(engine->events[e].kind)) {
+                subscriber->handler(&engine->events[e], prev, next, subscriber->context);
+            }
+        }
+    }
+
+    engine->last_ns = monotonic_ns() - start;
+    return engine->event_count;
+}
+
+const char* change_kind_name(ChangeKind kind) {
+    switch (kind) {
+        case EVENT_BORN:      return "born";
+        case EVENT_DIED:      return "died";
+        case EVENT_STATE:     return "state";
+        case EVENT_COMMAND:   return "command";
+        case EVENT_THRESHOLD: return "threshold";
+        default:              return "?";
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdint.h>
+#include "snapshot.h"
+#include "sort.h"
+
+/* ========== Change Events ========== */
+
+/*
+ * What changed between two consecutive snapshots, worked out once per tick
+ * and handed to every subscriber, so the UI, alerting or a recorder do not
+ * each diff the tables themselves.
+ */
+typedef enum {
+    EVENT_BORN,        /* New tid, or a tid reused by a new task */
+    EVENT_DIED,
+    EVENT_STATE,       /* e.g. Sleeping -> Disk sleep */
+    EVENT_COMMAND,     /* The task exec()ed or renamed itself */
+    EVENT_THRESHOLD,   /* A watched column crossed its limit */
+    EVENT_KIND_COUNT
+} ChangeKind;
+
+#define EVENT_BIT(kind) (1u << (kind))
+#define EVENT_ALL ((1u << EVENT_KIND_COUNT) - 1)
+
+typedef struct {
+    ChangeKind kind;
+    int pid;
+    int tid;
+    int row;           /* In the new snapshot; in the old one for EVENT_DIED */
+    union {
+        struct { char from, to; } state;
+        struct { int from, to; } command;         /* Interned command ids */
+        struct { int index, rising; } threshold;  /* Into DiffEngine.thresholds */
+    } change;
+} ChangeEvent;
+
+/* Called once per matching event, in (pid, tid) order */
+typedef void (*ChangeHandler)(const ChangeEvent *event, const Snapshot *prev,
+                              const Snapshot *next, void *context);
+
+#define DIFF_MAX_THRESHOLDS 8
+#define DIFF_MAX_SUBSCRIBERS 8
+
+typedef struct {
+    ColumnId column;   /* A numeric column: CPU%, memory or I/O rate */
+    double limit;
+} Threshold;
+
+typedef struct {
+    unsigned kinds;    /* EVENT_BIT() mask */
+    ChangeHandler handler;
+    void *context;
+} Subscriber;
+
+typedef struct {
+    /* (pid, tid) order of the last snapshot diffed, kept for the next diff */
+    SortPair *order;
+    SortPair *prev_order;
+    int order_capacity;
+    int ordered_count;
+    const Snapshot *ordered;       /* Snapshot prev_order belongs to */
+    uint64_t ordered_taken_ns;     /* Pooled snapshots are reused, so check this too */
+    SortEngine sorter;             /* Only needed when /proc order was not sorted */
+
+    ChangeEvent *events;           /* The last diff's events */
+    int event_count;
+    int event_capacity;
+
+    Threshold thresholds[DIFF_MAX_THRESHOLDS];
+    int threshold_count;
+    Subscriber subscribers[DIFF_MAX_SUBSCRIBERS];
+    int subscriber_count;
+
+    /* Statistics from the last diff */
+    int counts[EVENT_KIND_COUNT];
+    uint64_t last_ns;
+    int last_sorted;               /* The new table was out of order and had to be sorted */
+} DiffEngine;
+
+/* ========== Diff Engine Functions ========== */
+
+void diff_engine_init(DiffEngine *engine);
+void diff_engine_free(DiffEngine *engine);
+
+/* Room for snapshots of this many tasks. Returns: -1 on allocation failure */
+int diff_engine_reserve(DiffEngine *engine, int tasks);
+
+/* Watch a numeric column. Returns: -1 if the table of thresholds is full */
+int diff_add_threshold(DiffEngine *engine, ColumnId column, double limit);
+
+/* Returns: -1 if there are too many subscribers */
+int diff_subscribe(DiffEngine *engine, unsigned kinds, ChangeHandler handler, void *context);
+
+/*
+ * Compare next against prev in one merge pass over both tables in (pid, tid)
+ * order, which is the order /proc lists them in, so sorting is normally a
+ * linear check. Tasks marked exited in prev were reported already and are
+ * skipped. Events are kept in engine->events and sent to the subscribers.
+ * prev may be NULL for the first snapshot, which yields no events.
+ * Returns: number of events, or -1 on allocation failure
+ */
+int diff_snapshots(DiffEngine *engine, const Snapshot *prev, const Snapshot *next);
+
+const char* change_kind_name(ChangeKind kind);
+
+#endif /* DIFF_H */
@@ -0,0 +1,132 @@
+#include "fd_list.h"
+#include "survival.h"
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <limits.h>
+
+/* ========== Listing ========== */
+
+static int grow_entries(FdList *list, int new_capacity) {
+    if (heap_frozen) return -1;
+    FdEntry *entries = realloc(list->entries, new_capacity * sizeof(FdEntry));
+    if (!entries) return -1;
+    list->entries = entries;
+    list->capacity = new_capacity;
+    return 0;
+}
+
+/* "socket:[1234]", "pipe:[1234]", "anon_inode:[eventfd]", or a path */
+static FdKind classify(const char *target) {
+    if (target[0] == '/') return FD_KIND_FILE;
+    if (strncmp(target, "socket:", 7) == 0) return FD_KIND_SOCKET;
+    if (strncmp(target, "pipe:", 5) == 0) return FD_KIND_PIPE;
+    if (strncmp(target, "anon_inode:", 11) == 0) return FD_KIND_ANON;
+    return FD_KIND_OTHER;
+}
+
+static int compare_fd(const void *a, const void *b) {
+    return ((const FdEntry *)a)->fd - ((const FdEntry *)b)->fd;
+}
+
+/* Returns: -1 with errno set; a descriptor closed while listing is skipped */
+static int list_fds(FdList *list) {
+    uint64_t start = monotonic_ns();
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/fd", list->pid);
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        list->error = errno;
+        list->listed_ns = start;
+        return -1;
+    }
+
+    arena_reset(&list->targets);
+    memset(list->kinds, 0, sizeof(list->kinds));
+    list->count = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+
+        char link[PATH_MAX];
+        snprintf(path, sizeof(path), "/proc/%d/fd/%.16s", list->pid, entry->d_name);
+        ssize_t len = readlink(path, link, sizeof(link) - 1);
+        if (len < 0) continue;
+        link[len] = '\0';
+
+        if (list->count == list->capacity &&
+            grow_entries(list, list->capacity ? list->capacity * 2 : 64) < 0) {
+            closedir(dir);
+            list->error = ENOMEM;
+            errno = ENOMEM;
+            return -1;
+        }
+        const char *target = arena_strndup(&list->targets, link, len);
+        if (!target) {
+            closedir(dir);
+            list->error = ENOMEM;
+            errno = ENOMEM;
+            return -1;
+        }
+
+        FdEntry *fd = &list->entries[list->count++];
+        fd->fd = atoi(entry->d_name);
+        fd->kind = classify(target);
+        fd->target = target;
+        list->kinds[fd->kind]++;
+    }
+    closedir(dir);
+
+    qsort(list->entries, list->count, sizeof(FdEntry), compare_fd);
+    list->error = 0;
+    list->listed_ns = start;
+    list->list_ns = monotonic_ns() - start;
+    return 1;
+}
+
+/* ========== Public Interface ========== */
+
+int fd_list_open(FdList *list, int pid) {
+    memset(list, 0, sizeof(*list));
+    if (heap_frozen) {
+        errno = ENOMEM;
+        return -1;
+    }
+    list->pid = pid;
+    arena_init(&list->targets, 16 * 1024);
+    if (list_fds(list) < 0) {
+        int saved = errno;
+        fd_list_close(list);
+        errno = saved;
+        return -1;
+    }
+    list->active = 1;
+    return 0;
+}
+
+void fd_list_close(FdList *list) {
+    free(list->entries);
+    arena_free(&list->targets);
+    memset(list, 0, sizeof(*list));
+}
+
+int fd_list_poll(FdList *list) {
+    if (!list->active || monotonic_ns() - list->listed_ns < FD_LIST_PERIOD_NS) return 0;
+    return list_fds(list);
+}
+
+const char* fd_kind_name(FdKind kind) {
+    switch (kind) {
+        case FD_KIND_FILE:   return "file";
+        case FD_KIND_SOCKET: return "socket";
+        case FD_KIND_PIPE:   return "pipe";
+        case FD_KIND_ANON:   return "anon";
+        default:             return "other";
+    }
+}
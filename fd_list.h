@@ -0,0 +1,58 @@
+#ifndef FD_LIST_H
+#define FD_LIST_H
+
+#include <stdint.h>
+#include "arena.h"
+
+/* ========== Descriptor List ========== */
+
+/*
+ * The open descriptors of one process, for when its count in the task list
+ * looks wrong. Collection only counts descriptors; this lists them, reading
+ * the link of each /proc/[pid]/fd entry, and only for the one process being
+ * looked at. The list is read again every FD_LIST_PERIOD_NS while it is
+ * open, with the targets in an arena that is reset each time.
+ */
+
+#define FD_LIST_PERIOD_NS (5ULL * 1000000000ULL)
+
+typedef enum {
+    FD_KIND_FILE,
+    FD_KIND_SOCKET,
+    FD_KIND_PIPE,
+    FD_KIND_ANON,      /* anon_inode: eventfd, epoll, timerfd, ... */
+    FD_KIND_OTHER,
+    FD_KIND_COUNT
+} FdKind;
+
+typedef struct {
+    int fd;
+    FdKind kind;
+    const char *target;        /* In the list's arena, valid until the next listing */
+} FdEntry;
+
+typedef struct {
+    int active;
+    int pid;
+    uint64_t listed_ns;
+    int error;                 /* errno of the last failed listing, 0 = none */
+
+    FdEntry *entries;          /* By descriptor number */
+    int count;
+    int capacity;
+    Arena targets;
+    int kinds[FD_KIND_COUNT];
+
+    uint64_t list_ns;          /* Time the last listing took */
+} FdList;
+
+/* List the descriptors of pid. Returns: -1 with errno set */
+int fd_list_open(FdList *list, int pid);
+void fd_list_close(FdList *list);
+
+/* List again if FD_LIST_PERIOD_NS has passed. Returns: 1 if listed, 0 if not due, -1 with errno set */
+int fd_list_poll(FdList *list);
+
+const char* fd_kind_name(FdKind kind);
+
+#endif /* FD_LIST_H */
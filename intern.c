@@ -0,0 +1,147 @@
+#include "intern.h"
+#include "survival.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NAMES_BLOCK_SIZE (16 * 1024)
+
+/* ========== Hashing ========== */
+
+static uint32_t hash_string(const char *str) {
+    uint32_t hash = 2166136261u;  /* FNV-1a */
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int grow_slots(InternTable *table, int new_count) {
+    if (heap_frozen) return -1;
+    int *new_slots = calloc(new_count, sizeof(int));
+    if (!new_slots) return -1;
+
+    for (int id = 0; id < table->count; id++) {
+        uint32_t pos = hash_string(table->strings[id]) & (new_count - 1);
+        while (new_slots[pos]) pos = (pos + 1) & (new_count - 1);
+        new_slots[pos] = id + 1;
+    }
+
+    free(table->slots);
+    table->slots = new_slots;
+    table->slot_count = new_count;
+    return 0;
+}
+
+static int grow_ids(InternTable *table, int new_capacity) {
+    if (heap_frozen) return -1;
+
+    char **new_strings = realloc(table->strings, new_capacity * sizeof(char*));
+    if (!new_strings) return -1;
+    table->strings = new_strings;
+
+    uint32_t *new_ranks = realloc(table->ranks, new_capacity * sizeof(uint32_t));
+    if (!new_ranks) return -1;
+    table->ranks = new_ranks;
+
+    int *new_order = realloc(table->order, new_capacity * sizeof(int));
+    if (!new_order) return -1;
+    table->order = new_order;
+
+    table->capacity = new_capacity;
+    return 0;
+}
+
+/* ========== Public Interface ========== */
+
+void intern_init(InternTable *table) {
+    memset(table, 0, sizeof(*table));
+    arena_init(&table->names, NAMES_BLOCK_SIZE);
+}
+
+void intern_free(InternTable *table) {
+    arena_free(&table->names);
+    free(table->strings);
+    free(table->ranks);
+    free(table->order);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+int intern_reserve(InternTable *table, int count, size_t avg_len) {
+    int slot_count = table->slot_count ? table->slot_count : 64;
+    while (slot_count < count * 2) slot_count *= 2;
+
+    if (slot_count > table->slot_count && grow_slots(table, slot_count) < 0) return -1;
+    if (count > table->capacity && grow_ids(table, count) < 0) return -1;
+    return arena_reserve(&table->names, (count - table->count) * (avg_len + 1));
+}
+
+/* Returns: the slot holding str, or the empty slot where it would go */
+static uint32_t find_slot(const InternTable *table, const char *str) {
+    uint32_t pos = hash_string(str) & (table->slot_count - 1);
+    while (table->slots[pos]) {
+        if (strcmp(table->strings[table->slots[pos] - 1], str) == 0) break;
+        pos = (pos + 1) & (table->slot_count - 1);
+    }
+    return pos;
+}
+
+int intern_find(const InternTable *table, const char *str) {
+    if (!table->slot_count) return -1;
+    uint32_t pos = find_slot(table, str);
+    return table->slots[pos] ? table->slots[pos] - 1 : -1;
+}
+
+int intern_string(InternTable *table, const char *str) {
+    uint32_t pos = 0;
+    if (table->slot_count) {
+        pos = find_slot(table, str);
+        if (table->slots[pos]) return table->slots[pos] - 1;
+    }
+
+    /* Keep the load factor below 1/2. Lookups above still work once the
+     * table is full and the heap is frozen; only new strings fail */
+    if ((table->count + 1) * 2 > table->slot_count) {
+        if (grow_slots(table, table->slot_count ? table->slot_count * 2 : 64) < 0) return -1;
+        pos = find_slot(table, str);
+    }
+
+    if (table->count == table->capacity &&
+        grow_ids(table, table->capacity ? table->capacity * 2 : 64) < 0) {
+        return -1;
+    }
+
+    /* Strings are never removed, so they live in an arena that is never reset */
+    char *copy = arena_strndup(&table->names, str, strlen(str));
+    if (!copy) return -1;
+
+    int id = table->count++;
+    table->strings[id] = copy;
+    table->ranks[id] = 0;
+    table->slots[pos] = id + 1;
+    table->ranks_dirty = 1;
+    return id;
+}
+
+/* qsort() has no context argument, so the comparator reads the table from here */
+static const InternTable *rank_table;
+
+static int compare_ids(const void *a, const void *b) {
+    return strcmp(rank_table->strings[*(const int*)a], rank_table->strings[*(const int*)b]);
+}
+
+void intern_update_ranks(InternTable *table) {
+    if (!table->ranks_dirty) return;
+
+    int *ids = table->order;
+    for (int id = 0; id < table->count; id++) ids[id] = id;
+
+    rank_table = table;
+    qsort(ids, table->count, sizeof(int), compare_ids);
+    for (int rank = 0; rank < table->count; rank++) {
+        table->ranks[ids[rank]] = rank;
+    }
+
+    table->ranks_dirty = 0;
+}
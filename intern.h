@@ -0,0 +1,50 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+#include "arena.h"
+
+/* ========== String Interning ========== */
+
+/*
+ * Maps each distinct string to a small integer id. Besides equality checks,
+ * ids carry a rank (the string's position in strcmp order), so string
+ * columns can be sorted as plain integers.
+ */
+typedef struct {
+    char **strings;       /* id -> string, stored in names */
+    uint32_t *ranks;      /* id -> rank in sorted order */
+    int *order;           /* Scratch for the rank update */
+    int count;
+    int capacity;
+    int *slots;           /* open-addressing hash of id + 1, 0 = empty */
+    int slot_count;       /* always a power of two */
+    int ranks_dirty;      /* new strings were added since the last rank update */
+    Arena names;
+} InternTable;
+
+void intern_init(InternTable *table);
+void intern_free(InternTable *table);
+
+/* Make room for count strings of about avg_len bytes. Returns -1 on allocation failure */
+int intern_reserve(InternTable *table, int count, size_t avg_len);
+
+/* Return the id for str, adding it if needed. Returns -1 on allocation failure */
+int intern_string(InternTable *table, const char *str);
+
+/* Return the id for str without adding it. Returns -1 if it was never interned */
+int intern_find(const InternTable *table, const char *str);
+
+/* Recompute ranks after new strings were added (cheap no-op otherwise) */
+void intern_update_ranks(InternTable *table);
+
+static inline const char* intern_lookup(const InternTable *table, int id) {
+    return table->strings[id];
+}
+
+/* Only valid after intern_update_ranks() */
+static inline uint32_t intern_rank(const InternTable *table, int id) {
+    return table->ranks[id];
+}
+
+#endif /* INTERN_H */
@@ -0,0 +1,68 @@
+#include "intmap.h"
+#include "survival.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int slot_for(int key, int slot_count) {
+    /* Multiplicative hash; consecutive tids land far apart */
+    return ((unsigned int)key * 2654435761u) & (unsigned int)(slot_count - 1);
+}
+
+void intmap_init(IntMap *map) {
+    memset(map, 0, sizeof(*map));
+}
+
+void intmap_free(IntMap *map) {
+    free(map->keys);
+    free(map->values);
+    memset(map, 0, sizeof(*map));
+}
+
+int intmap_reset(IntMap *map, int expected) {
+    /* Keep the load factor at or below 1/2 */
+    int needed = 16;
+    while (needed < expected * 2) needed *= 2;
+
+    if (needed > map->slot_count) {
+        if (heap_frozen) return -1;
+        int *keys = realloc(map->keys, needed * sizeof(int));
+        if (!keys) return -1;
+        map->keys = keys;
+
+        int *values = realloc(map->values, needed * sizeof(int));
+        if (!values) return -1;
+        map->values = values;
+        map->slot_count = needed;
+    }
+
+    memset(map->keys, 0xff, map->slot_count * sizeof(int));
+    map->count = 0;
+    return 0;
+}
+
+void intmap_put(IntMap *map, int key, int value) {
+    unsigned int mask = map->slot_count - 1;
+    unsigned int pos = slot_for(key, map->slot_count);
+
+    while (map->keys[pos] != -1 && map->keys[pos] != key) {
+        pos = (pos + 1) & mask;
+    }
+    if (map->keys[pos] == -1) {
+        map->keys[pos] = key;
+        map->count++;
+    }
+    map->values[pos] = value;
+}
+
+int intmap_get(const IntMap *map, int key) {
+    if (map->slot_count == 0) return -1;
+
+    unsigned int mask = map->slot_count - 1;
+    unsigned int pos = slot_for(key, map->slot_count);
+
+    while (map->keys[pos] != -1) {
+        if (map->keys[pos] == key) return map->values[pos];
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
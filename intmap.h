@@ -0,0 +1,30 @@
+#ifndef INTMAP_H
+#define INTMAP_H
+
+/* ========== Integer Hash Map ========== */
+
+/*
+ * Open-addressing map from non-negative int keys (pids, tids) to int
+ * values. Rebuilt every refresh, so there is no delete: intmap_reset()
+ * clears it and sizes it for the expected number of keys.
+ */
+typedef struct {
+    int *keys;       /* -1 = empty slot */
+    int *values;
+    int slot_count;  /* always a power of two */
+    int count;
+} IntMap;
+
+void intmap_init(IntMap *map);
+void intmap_free(IntMap *map);
+
+/* Clear the map and make room for expected keys. Returns -1 on allocation failure */
+int intmap_reset(IntMap *map, int expected);
+
+/* Insert or overwrite. The map must have been reset for at least this many keys */
+void intmap_put(IntMap *map, int key, int value);
+
+/* Returns: the value for key, or -1 if absent */
+int intmap_get(const IntMap *map, int key);
+
+#endif /* INTMAP_H */
@@ -0,0 +1,83 @@
+#include "keymap.h"
+#include "survival.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int slot_for(int id, uint64_t stamp, int slot_count) {
+    uint64_t key = ((uint64_t)(unsigned int)id << 32) ^ stamp;
+    key *= 0x9e3779b97f4a7c15ULL;
+    return (unsigned int)(key >> 32) & (unsigned int)(slot_count - 1);
+}
+
+/* Move every key into a table of slot_count slots */
+static int rehash(KeyMap *map, int slot_count) {
+    if (heap_frozen) return -1;
+    KeySlot *slots = malloc(slot_count * sizeof(KeySlot));
+    if (!slots) return -1;
+    for (int i = 0; i < slot_count; i++) slots[i].value = -1;
+
+    unsigned int mask = slot_count - 1;
+    for (int i = 0; i < map->slot_count; i++) {
+        const KeySlot *slot = &map->slots[i];
+        if (slot->value < 0) continue;
+        unsigned int pos = slot_for(slot->id, slot->stamp, slot_count);
+        while (slots[pos].value >= 0) pos = (pos + 1) & mask;
+        slots[pos] = *slot;
+    }
+
+    free(map->slots);
+    map->slots = slots;
+    map->slot_count = slot_count;
+    return 0;
+}
+
+void keymap_init(KeyMap *map) {
+    memset(map, 0, sizeof(*map));
+}
+
+void keymap_free(KeyMap *map) {
+    free(map->slots);
+    memset(map, 0, sizeof(*map));
+}
+
+int keymap_reserve(KeyMap *map, int keys) {
+    /* Keep the load factor at or below 1/2 */
+    int needed = map->slot_count ? map->slot_count : 64;
+    while (needed < keys * 2) needed *= 2;
+    return needed > map->slot_count ? rehash(map, needed) : 0;
+}
+
+void keymap_clear(KeyMap *map) {
+    for (int i = 0; i < map->slot_count; i++) map->slots[i].value = -1;
+    map->count = 0;
+}
+
+int keymap_put(KeyMap *map, int id, uint64_t stamp, int value) {
+    if (keymap_reserve(map, map->count + 1) < 0) return -1;
+
+    unsigned int mask = map->slot_count - 1;
+    unsigned int pos = slot_for(id, stamp, map->slot_count);
+    while (map->slots[pos].value >= 0 &&
+           (map->slots[pos].id != id || map->slots[pos].stamp != stamp)) {
+        pos = (pos + 1) & mask;
+    }
+    if (map->slots[pos].value < 0) {
+        map->slots[pos].id = id;
+        map->slots[pos].stamp = stamp;
+        map->count++;
+    }
+    map->slots[pos].value = value;
+    return 0;
+}
+
+int keymap_get(const KeyMap *map, int id, uint64_t stamp) {
+    if (map->slot_count == 0) return -1;
+
+    unsigned int mask = map->slot_count - 1;
+    unsigned int pos = slot_for(id, stamp, map->slot_count);
+    while (map->slots[pos].value >= 0) {
+        if (map->slots[pos].id == id && map->slots[pos].stamp == stamp) return map->slots[pos].value;
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
@@ -0,0 +1,43 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdint.h>
+
+/* ========== Keyed Entry Index ========== */
+
+/*
+ * Open-addressing map from an (id, stamp) pair to the index of an entry in
+ * a dense array the caller owns. Processes are keyed by (pid, starttime), so
+ * a recycled pid is a different key; uids use a stamp of 0. The keys live in
+ * the slots, so the map grows without looking at the caller's entries. There
+ * is no delete: a caller that compacts its array clears the map and puts the
+ * survivors back, which never needs more room than it already has.
+ */
+typedef struct {
+    uint64_t stamp;
+    int id;
+    int value;       /* -1 = empty slot */
+} KeySlot;
+
+typedef struct {
+    KeySlot *slots;
+    int slot_count;  /* always a power of two, or 0 before the first put */
+    int count;
+} KeyMap;
+
+void keymap_init(KeyMap *map);
+void keymap_free(KeyMap *map);
+
+/* Make room for this many keys, for survival mode. Returns: -1 on allocation failure */
+int keymap_reserve(KeyMap *map, int keys);
+
+/* Forget every key; the room is kept */
+void keymap_clear(KeyMap *map);
+
+/* Insert or overwrite, growing as needed. Returns: -1 on allocation failure */
+int keymap_put(KeyMap *map, int id, uint64_t stamp, int value);
+
+/* Returns: the value for (id, stamp), or -1 if absent */
+int keymap_get(const KeyMap *map, int id, uint64_t stamp);
+
+#endif /* KEYMAP_H */
@@ -0,0 +1,21 @@
+#include "layout.h"
+
+#define TITLE_LINES 3         /* Title + state histogram + separator */
+#define LIST_HEADER_LINES 2   /* Column headers + separator */
+#define FOOTER_LINES 1
+
+Layout layout_compute(int rows, int cols, int debug_panel) {
+    Layout layout;
+    layout.rows = rows;
+    layout.cols = cols;
+    layout.footer_y = rows - FOOTER_LINES;
+    layout.debug_top = layout.footer_y - DEBUG_PANEL_LINES;
+    layout.list_top = TITLE_LINES;
+    layout.table_top = layout.list_top + LIST_HEADER_LINES;
+
+    /* The debug panel's title bar sits directly above it */
+    int list_end = debug_panel ? layout.debug_top - 1 : layout.footer_y;
+    layout.list_lines = list_end - layout.table_top;
+    if (layout.list_lines < 0) layout.list_lines = 0;
+    return layout;
+}
@@ -0,0 +1,26 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+/* ========== Screen Layout ========== */
+
+/* Lines of the debug panel, not counting its title bar */
+#define DEBUG_PANEL_LINES 18
+
+/*
+ * Where each pane goes for a terminal size. Computed once per resize (or
+ * when the debug panel is toggled) and read by the draw_* functions and the
+ * input handler, which used to redo this arithmetic on every call.
+ */
+typedef struct {
+    int rows;
+    int cols;
+    int list_top;         /* Column headers of the task or aggregate list */
+    int table_top;        /* First list row, under the headers and separator */
+    int list_lines;       /* List rows that fit; never negative */
+    int debug_top;        /* First line of the debug panel, its title bar is above */
+    int footer_y;
+} Layout;
+
+Layout layout_compute(int rows, int cols, int debug_panel);
+
+#endif /* LAYOUT_H */
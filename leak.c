@@ -0,0 +1,208 @@
+#include "leak.h"
+#include "snapshot.h"
+#include "survival.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ========== Entries ========== */
+
+static int grow_entries(LeakTracker *tracker, int new_capacity) {
+    if (heap_frozen) return -1;
+    LeakEntry *entries = realloc(tracker->entries, new_capacity * sizeof(LeakEntry));
+    if (!entries) return -1;
+    tracker->entries = entries;
+
+    int *suspects = realloc(tracker->suspects, new_capacity * sizeof(int));
+    if (!suspects) return -1;
+    tracker->suspects = suspects;
+
+    tracker->capacity = new_capacity;
+    return 0;
+}
+
+/* Returns: a new, empty entry, or NULL */
+static LeakEntry* add_entry(LeakTracker *tracker, int pid, unsigned long long starttime) {
+    if (tracker->count == tracker->capacity &&
+        grow_entries(tracker, tracker->capacity ? tracker->capacity * 2 : 128) < 0) {
+        return NULL;
+    }
+    if (keymap_put(&tracker->index, pid, starttime, tracker->count) < 0) return NULL;
+
+    LeakEntry *entry = &tracker->entries[tracker->count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->pid = pid;
+    entry->starttime = starttime;
+    return entry;
+}
+
+/* ========== Fitting ========== */
+
+/* Move the origin of t forward by shift seconds, without the samples */
+static void shift_sums(LeakSums *sums, double shift) {
+    sums->tt += -2.0 * shift * sums->t + sums->n * shift * shift;
+    sums->ty -= shift * sums->y;
+    sums->t -= sums->n * shift;
+}
+
+/* Slope per second and R^2 of the line through sums. Returns: -1 if too few distinct times */
+static int fit_line(const LeakSums *sums, double *slope, double *fit) {
+    double time_spread = sums->n * sums->tt - sums->t * sums->t;
+    if (sums->n < 2 || time_spread <= 0.0) return -1;
+
+    double covariance = sums->n * sums->ty - sums->t * sums->y;
+    double value_spread = sums->n * sums->yy - sums->y * sums->y;
+    *slope = covariance / time_spread;
+    *fit = value_spread > 0.0 ? covariance * covariance / (time_spread * value_spread) : 0.0;
+    return 0;
+}
+
+/*
+ * Once the current window is full it becomes the previous one and the origin
+ * moves to its start. After a gap of two windows or more (RSS not collected
+ * meanwhile) nothing of the old fit is left.
+ */
+static void add_sample(LeakEntry *entry, uint64_t sampled_ns, unsigned long long rss) {
+    if (entry->current.n == 0 && entry->previous.n == 0) {
+        entry->base_ns = sampled_ns;
+        entry->window_ns = sampled_ns;
+        entry->base_rss = rss;
+    }
+    if (sampled_ns - entry->window_ns >= LEAK_WINDOW_NS) {
+        if (entry->current.n > 0 && sampled_ns - entry->window_ns < 2 * LEAK_WINDOW_NS) {
+            entry->previous = entry->current;
+            shift_sums(&entry->previous, (entry->window_ns - entry->base_ns) / 1e9);
+            entry->base_ns = entry->window_ns;
+        } else {
+            memset(&entry->previous, 0, sizeof(entry->previous));
+            entry->base_ns = sampled_ns;
+        }
+        memset(&entry->current, 0, sizeof(entry->current));
+        entry->window_ns = sampled_ns;
+    }
+
+    double t = (sampled_ns - entry->base_ns) / 1e9;
+    double y = (double)rss - (double)entry->base_rss;
+    LeakSums *sums = &entry->current;
+    sums->n += 1.0;
+    sums->t += t;
+    sums->y += y;
+    sums->tt += t * t;
+    sums->ty += t * y;
+    sums->yy += y * y;
+
+    LeakSums both = entry->previous;
+    both.n += sums->n;
+    both.t += sums->t;
+    both.y += sums->y;
+    both.tt += sums->tt;
+    both.ty += sums->ty;
+    both.yy += sums->yy;
+
+    double slope = 0.0;
+    double fit = 0.0;
+    fit_line(&both, &slope, &fit);
+    entry->rate = slope * 3600.0;
+    entry->fit = fit;
+    entry->rss = rss;
+    entry->sampled_ns = sampled_ns;
+}
+
+int leak_entry_judged(const LeakEntry *entry) {
+    return entry->previous.n + entry->current.n >= LEAK_MIN_SAMPLES &&
+           entry->sampled_ns - entry->base_ns >= LEAK_MIN_SPAN_NS;
+}
+
+/* Growth must also show in the previous window on its own, when there is one */
+static int is_suspect(const LeakEntry *entry) {
+    if (!leak_entry_judged(entry) || entry->rate < LEAK_MIN_RATE || entry->fit < LEAK_MIN_FIT) return 0;
+
+    double slope, fit;
+    if (entry->previous.n >= 2 && fit_line(&entry->previous, &slope, &fit) == 0 && slope <= 0.0) return 0;
+    return 1;
+}
+
+/* ========== Public Interface ========== */
+
+void leak_tracker_init(LeakTracker *tracker) {
+    memset(tracker, 0, sizeof(*tracker));
+    keymap_init(&tracker->index);
+    tracker->generation = 1;
+}
+
+void leak_tracker_free(LeakTracker *tracker) {
+    free(tracker->entries);
+    keymap_free(&tracker->index);
+    free(tracker->suspects);
+    memset(tracker, 0, sizeof(*tracker));
+}
+
+int leak_tracker_reserve(LeakTracker *tracker, int processes) {
+    if (keymap_reserve(&tracker->index, processes) < 0) return -1;
+    if (processes > tracker->capacity && grow_entries(tracker, processes) < 0) return -1;
+    return 0;
+}
+
+/* qsort() has no context argument, so the comparator reads the tracker from here */
+static const LeakTracker *rank_tracker;
+
+static int compare_rate_desc(const void *a, const void *b) {
+    const LeakEntry *ea = &rank_tracker->entries[*(const int *)a];
+    const LeakEntry *eb = &rank_tracker->entries[*(const int *)b];
+    if (ea->rate != eb->rate) return ea->rate < eb->rate ? 1 : -1;
+    return ea->pid - eb->pid;
+}
+
+int leak_tracker_update(LeakTracker *tracker, const Snapshot *snapshot) {
+    int result = 0;
+    tracker->generation++;
+
+    for (int i = 0; i < snapshot->count; i++) {
+        const TaskInfo *task = &snapshot->tasks[i];
+        if (task->tid != task->pid || task->exited || task->kernel_thread) continue;
+
+        int index = keymap_get(&tracker->index, task->pid, task->starttime);
+        LeakEntry *entry = index >= 0 ? &tracker->entries[index] : NULL;
+        if (!entry) {
+            entry = add_entry(tracker, task->pid, task->starttime);
+            if (!entry) {
+                result = -1;
+                continue;
+            }
+        }
+        entry->last_seen = tracker->generation;
+        entry->command_id = task->command_id;
+
+        /* Threads share the leader's memory, so its RSS stands for the process */
+        uint64_t sampled_ns = task->sampled_ns[SOURCE_STATM];
+        if ((task->collected & FIELD_BIT(FIELD_MEMORY)) && sampled_ns > entry->sampled_ns) {
+            add_sample(entry, sampled_ns, task->rss);
+        }
+    }
+
+    /* Drop processes this update did not see and index the rest where they
+     * now are; a truncated survival snapshot may miss a live one for a tick,
+     * which only costs it its history */
+    int kept = 0;
+    for (int i = 0; i < tracker->count; i++) {
+        if (tracker->entries[i].last_seen == tracker->generation) {
+            tracker->entries[kept++] = tracker->entries[i];
+        } else {
+            tracker->evictions++;
+        }
+    }
+    if (kept != tracker->count) {
+        tracker->count = kept;
+        keymap_clear(&tracker->index);
+        for (int i = 0; i < kept; i++) {
+            keymap_put(&tracker->index, tracker->entries[i].pid, tracker->entries[i].starttime, i);
+        }
+    }
+
+    tracker->suspect_count = 0;
+    for (int i = 0; i < tracker->count; i++) {
+        if (is_suspect(&tracker->entries[i])) tracker->suspects[tracker->suspect_count++] = i;
+    }
+    rank_tracker = tracker;
+    qsort(tracker->suspects, tracker->suspect_count, sizeof(int), compare_rate_desc);
+    return result;
+}
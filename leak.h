@@ -0,0 +1,93 @@
+#ifndef LEAK_H
+#define LEAK_H
+
+#include <stdint.h>
+#include "keymap.h"
+
+/* ========== Leak Suspects ========== */
+
+/*
+ * A least-squares line through each process's RSS samples, kept as running
+ * sums so a sample costs O(1) and a process a fixed-size entry whatever its
+ * age. The fit slides by whole windows: sums are kept for the current window
+ * and the one before it, and when the current one has run for
+ * LEAK_WINDOW_NS the older is dropped. The slope therefore always covers
+ * between one and two windows of the recent past.
+ *
+ * A process is a suspect when its RSS grows by at least LEAK_MIN_RATE per
+ * hour, the line explains most of the variation (a heap that grows and is
+ * collected again does not fit a line), and growth was already under way in
+ * the previous window.
+ *
+ * Entries are keyed by (pid, starttime) like the command line cache, and
+ * dropped at the first update that no longer sees their process.
+ */
+
+#define LEAK_WINDOW_NS (15ULL * 60 * 1000000000ULL)
+#define LEAK_MIN_SPAN_NS (5ULL * 60 * 1000000000ULL)   /* Watched this long before judging */
+#define LEAK_MIN_SAMPLES 8
+#define LEAK_MIN_RATE (1024.0 * 1024.0)                 /* Bytes per hour */
+#define LEAK_MIN_FIT 0.5                                /* R^2 of the line */
+
+struct Snapshot;
+
+typedef struct {
+    double n;
+    double t;      /* Seconds since the entry's base_ns */
+    double y;      /* Bytes above the entry's base_rss */
+    double tt;
+    double ty;
+    double yy;
+} LeakSums;
+
+typedef struct {
+    int pid;
+    unsigned long long starttime;
+    int command_id;             /* Interned command, for the view */
+    unsigned long long rss;     /* Latest sample */
+    uint64_t base_ns;           /* Origin of t: the first sample still in the fit */
+    uint64_t window_ns;         /* Start of the current window */
+    uint64_t sampled_ns;        /* Latest sample; carried values are not counted twice */
+    unsigned long long base_rss;
+    LeakSums previous;
+    LeakSums current;
+    double rate;                /* Bytes per hour over both windows */
+    double fit;                 /* R^2 over both windows */
+    uint32_t last_seen;         /* Generation of the last update that saw the process */
+} LeakEntry;
+
+typedef struct {
+    LeakEntry *entries;         /* Dense array, compacted when processes go */
+    int count;
+    int capacity;
+    KeyMap index;               /* (pid, starttime) -> entry */
+    uint32_t generation;
+
+    int *suspects;              /* Entry indices, fastest growth first; sized like entries */
+    int suspect_count;
+
+    unsigned long evictions;
+} LeakTracker;
+
+void leak_tracker_init(LeakTracker *tracker);
+void leak_tracker_free(LeakTracker *tracker);
+
+/* Make room for this many processes, for survival mode. Returns: -1 on allocation failure */
+int leak_tracker_reserve(LeakTracker *tracker, int processes);
+
+/*
+ * Add each process leader's freshly read RSS, drop processes that have gone
+ * and rebuild the suspect list.
+ * Returns: -1 if a new process could not be added (it is tried again next time)
+ */
+int leak_tracker_update(LeakTracker *tracker, const struct Snapshot *snapshot);
+
+/* Returns: 1 if the entry has been watched long enough to be judged */
+int leak_entry_judged(const LeakEntry *entry);
+
+/* Time covered by the entry's fit */
+static inline double leak_entry_span(const LeakEntry *entry) {
+    return (entry->sampled_ns - entry->base_ns) / 1e9;
+}
+
+#endif /* LEAK_H */
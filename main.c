@@ -5,7 +5,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ncurses.h>
 #include <unistd.h>
 #include <sys/select.h>
 #include <sys/time.h>
@@ -18,24 +17,160 @@
 #include <string.h>
 
 #include "task_data.h"
+#include "snapshot.h"
+#include "sort.h"
+#include "columns.h"
+#include "aggregate.h"
+#include "diff.h"
+#include "leak.h"
+#include "user_cache.h"
+#include "plugin.h"
+#include "profiler.h"
+#include "smaps.h"
+#include "fd_list.h"
+#include "survival.h"
+#include "render.h"
+#include "layout.h"
+#include "timing.h"
+
+#define REFRESH_INTERVAL_NS 1000000000ULL
+#define DEFAULT_READ_BUDGET 20000  /* File reads per tick for off-screen tasks */
+#define TOP_CONTRIBUTORS 32        /* Busiest tasks read exactly while sampling */
+#define SURVIVAL_DUTY_PERCENT 25   /* Survival mode: most of each interval is left idle */
+#define SURVIVAL_COMMANDS 4096     /* Distinct command names reserved for survival mode */
+#define SURVIVAL_USERS 1024        /* Distinct users reserved for survival mode */
+#define SURVIVAL_WAIT_CHANNELS 512 /* Distinct wait channels reserved for survival mode */
+#define CPU_ALERT_PERCENT 90.0     /* Crossing this raises a threshold event */
+#define MAX_HIGHLIGHTS 256         /* Born and dead rows highlighted per tick */
+#define RESIZE_FRAME_NS 16000000ULL  /* During a window drag, re-layout at most once per frame */
 
 /* ========== Global State ========== */
 
 int running = 1;
 int debug_mode = 0;
 volatile sig_atomic_t resize_pending = 0;
+volatile sig_atomic_t sigwinch_count = 0;
+
+/* Pane geometry for the current terminal size */
+Layout layout;
+static uint64_t last_layout_ns = 0;
 
-/* Task list state */
-TaskInfo tasks[MAX_TASKS];
-int task_count = 0;
+/* Task list state: the snapshot on screen and the one before it */
+Snapshot *snapshot = NULL;
+Snapshot *prev_snapshot = NULL;
 int selected_index = 0;  /* Currently selected row */
 int scroll_offset = 0;   /* Top visible row */
 
+/* Sorted view: view_rows[i] is the index into snapshot->tasks shown on line i */
+int *view_rows = NULL;
+int view_count = 0;
+ColumnId sort_key = COL_PID;
+int sort_descending = 0;
+SortEngine sort_engine;
+
+/* Only tasks whose command or command line contains filter_text are shown */
+char filter_text[64] = "";
+int hide_kernel_threads = 0;
+
+/* Line prompts on the footer; while one is open it receives every key */
+typedef enum {
+    PROMPT_NONE,
+    PROMPT_FILTER,
+    PROMPT_JUMP,    /* Jump to a pid or tid */
+    PROMPT_SEARCH   /* Move to the next row whose command contains search_text */
+} Prompt;
+
+Prompt prompt = PROMPT_NONE;
+char jump_text[16] = "";
+char search_text[64] = "";
+char status_text[80] = "";  /* One-off message on the footer, cleared by the next key */
+
+/* Previous frame's order (rows of prev_snapshot); seeds the adaptive re-sort */
+int *prev_view_rows = NULL;
+int prev_view_count = 0;
+int view_capacity = 0;
+unsigned char *row_placed = NULL;
+
+/* Inverse of view_rows: view_pos[row] is the line showing snapshot->tasks[row], -1 if filtered out */
+int *view_pos = NULL;
+
+/* Fields and files read by the last refresh */
+CollectPlan collect_plan;
+
+/* Tasks read every tick whatever the budget; the rest take turns */
+IntMap priority_tids;
+
+/* Filter matches whose wait channel is read while the wait view is open */
+IntMap wait_tids;
+int read_budget = DEFAULT_READ_BUDGET;
+
+/* Aggregate view: per-command, per-user or per-wait-channel totals, estimated
+ * from a sample below 1.0 */
+int aggregate_view = 0;
+AggregateKey aggregate_key = AGGREGATE_BY_COMMAND;
+int aggregate_scroll = 0;
+int aggregate_selected = 0;
+
+/* Drill-down: the task list narrowed to one aggregate row's tasks */
+int drill_view = 0;
+AggregateKey drill_by;
+int drill_key;
+char kernel_stack[256];  /* Of the selected thread, while drilled into a wait channel */
+int kernel_stack_errno = 0;
+double sample_fraction = 1.0;
+Aggregates aggregates;
+
+uint64_t last_refresh_ns = 0;
+uint64_t refresh_interval_ns = REFRESH_INTERVAL_NS;
+
+/* Survival mode: tasks preallocated for before locking memory, 0 = off */
+int survival_tasks = 0;
+
+/* What changed since the last tick */
+DiffEngine diff_engine;
+
+/* Tasks born or died this tick, taken from the change stream; dead ones
+ * stay on screen for one more tick */
+typedef struct {
+    int tid;
+    int row;          /* In the snapshot the event refers to */
+    ChangeKind kind;
+} Highlight;
+
+static Highlight highlights[MAX_HIGHLIGHTS];
+static int highlight_count = 0;
+IntMap highlight_tids;  /* tid -> ChangeKind, for drawing */
+
+/* RSS growth per process, and the view of the ones that look like leaks */
+LeakTracker leak_tracker;
+int leak_view = 0;
+int leak_scroll = 0;
+int leak_selected = 0;
+
+/* Sampling profiler of the selected process; its table replaces the task list */
+Profiler profiler;
+int profile_scroll = 0;
+
+/* Mapping growth of the selected process; its table replaces the task list */
+MappingTracker mapping_tracker;
+int mapping_scroll = 0;
+
+/* Open descriptors of the selected process; their table replaces the task list */
+FdList fd_list;
+int fd_scroll = 0;
+
+/* Threads in each state over the window, for the header */
+static double state_window[STATE_COUNT];
+
+RenderBackend render_backend = BACKEND_NCURSES;
+static uint64_t last_sort_ns = 0;
+
 /* Debug statistics */
-static int resize_count = 0;
+static int layout_count = 0;
 static int select_timeout_count = 0;
 static int select_input_count = 0;
 static int select_interrupt_count = 0;
+static int coalesced_key_count = 0;  /* Keys handled without a redraw of their own */
 static int last_errno = 0;
 
 /* ========== Signal Handling ========== */
@@ -43,195 +178,1328 @@ static int last_errno = 0;
 void handle_sigwinch(int sig) {
     (void)sig;
     signal(SIGWINCH, handle_sigwinch);  /* Re-register to handle SysV reset */
+    sigwinch_count++;
     resize_pending = 1;
 }
 
+/* Recompute the pane geometry; nothing is re-read or re-sorted */
+static void update_layout(void) {
+    int rows, cols;
+    render_size(&rows, &cols);
+    layout = layout_compute(rows, cols, debug_mode);
+    layout_count++;
+}
+
+/* Apply every SIGWINCH received so far with one re-layout */
 void handle_resize(void) {
-    resize_count++;
-    endwin();
-    refresh();
+    resize_pending = 0;
+    render_resize();
+    update_layout();
+    last_layout_ns = monotonic_ns();
 }
 
 /* ========== UI Functions ========== */
 
-void init_ui(void) {
-    initscr();
-    cbreak();
-    noecho();
-    keypad(stdscr, TRUE);
-    curs_set(0);
+/* Returns: -1 if the terminal could not be set up */
+int init_ui(void) {
+    if (render_init(render_backend) < 0) return -1;
 
-    if (has_colors()) {
-        start_color();
-        init_pair(1, COLOR_CYAN, COLOR_BLACK);    /* Header */
-        init_pair(2, COLOR_GREEN, COLOR_BLACK);   /* Footer */
-        init_pair(3, COLOR_YELLOW, COLOR_BLACK);  /* Table header */
-        init_pair(4, COLOR_MAGENTA, COLOR_BLACK); /* Debug panel */
-        init_pair(5, COLOR_BLACK, COLOR_WHITE);   /* Selected row */
-        init_pair(6, COLOR_GREEN, COLOR_BLACK);   /* Running state */
-        init_pair(7, COLOR_BLUE, COLOR_BLACK);    /* Sleeping state */
-    }
+    render_init_pair(1, COLOR_CYAN, COLOR_BLACK);    /* Header */
+    render_init_pair(2, COLOR_GREEN, COLOR_BLACK);   /* Footer */
+    render_init_pair(3, COLOR_YELLOW, COLOR_BLACK);  /* Table header */
+    render_init_pair(4, COLOR_MAGENTA, COLOR_BLACK); /* Debug panel */
+    render_init_pair(5, COLOR_BLACK, COLOR_WHITE);   /* Selected row */
+    render_init_pair(6, COLOR_GREEN, COLOR_BLACK);   /* Running state */
+    render_init_pair(7, COLOR_BLUE, COLOR_BLACK);    /* Sleeping state */
+    render_init_pair(8, COLOR_RED, COLOR_BLACK);     /* Task that just exited */
+    update_layout();
+    return 0;
 }
 
 void cleanup_ui(void) {
-    endwin();
+    render_end();
+}
+
+/* Threads by state over the window, as numbers and one stacked bar */
+static void draw_state_histogram(int y, int max_x) {
+    static const char letters[STATE_COUNT] = {'R', 'S', 'D', 'Z', 'T'};
+    static const int colors[STATE_COUNT] = {ATTR_PAIR(6), ATTR_PAIR(7), ATTR_PAIR(3), ATTR_PAIR(8), ATTR_PAIR(4)};
+
+    double total = 0.0;
+    render_print(y, 0, "Threads, last %llus:", STATE_WINDOW_NS / 1000000000ULL);
+    for (int s = 0; s < STATE_COUNT; s++) {
+        render_append(" %c %.1f", letters[s], state_window[s]);
+        total += state_window[s];
+    }
+
+    /* The bar takes what is left of the line, split by cumulative rounding so
+     * the segments always add up to its width */
+    int x = 60;
+    int width = max_x - x - 3;
+    if (width < 10 || total <= 0.0) return;
+
+    render_print(y, x, "[");
+    double cumulative = 0.0;
+    int drawn = 0;
+    for (int s = 0; s < STATE_COUNT; s++) {
+        cumulative += state_window[s];
+        int end = (int)(cumulative / total * width + 0.5);
+        if (end > drawn) {
+            render_attron(colors[s] | ATTR_BOLD);
+            render_hline(y, x + 1 + drawn, letters[s], end - drawn);
+            render_attroff(colors[s] | ATTR_BOLD);
+            drawn = end;
+        }
+    }
+    render_print(y, x + 1 + width, "]");
+}
+
+static const char* aggregate_key_title(AggregateKey key) {
+    switch (key) {
+        case AGGREGATE_BY_USER: return "user";
+        case AGGREGATE_BY_WAIT: return "wait channel";
+        default:                return "command";
+    }
 }
 
 void draw_header(void) {
-    int max_x;
+    int max_x = layout.cols;
     char time_str[64];
 
-    max_x = getmaxx(stdscr);
-
     time_t current_time = time(NULL);
     struct tm *time_info = localtime(&current_time);
     strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", time_info);
 
-    attron(COLOR_PAIR(1) | A_BOLD);
-    mvprintw(0, 0, "ProcessExplorerLite");
-    mvprintw(0, max_x - strlen(time_str), "%s", time_str);
-    attroff(COLOR_PAIR(1) | A_BOLD);
-    mvhline(1, 0, '-', max_x);
+    render_attron(ATTR_PAIR(1) | ATTR_BOLD);
+    render_print(0, 0, "ProcessExplorerLite");
+    if (profiler.active) {
+        render_print(0, 22, "Profile pid %d | %lu samples in %.0f s | %d threads", profiler.pid,
+                     profiler.samples, (monotonic_ns() - profiler.started_ns) / 1e9, profiler.thread_count);
+        if (profiler.thread_count == 0) render_append(" (exited)");
+        if (profiler.thread_errors) render_append(" | %d not sampled", profiler.thread_errors);
+        if (profiler.lost) render_append(" | lost %lu", profiler.lost);
+    } else if (mapping_tracker.active) {
+        char rss[16];
+        char growth[16];
+        long change_kb = (long)mapping_tracker.rss_kb - (long)mapping_tracker.first_rss_kb;
+        format_bytes(mapping_tracker.rss_kb * 1024.0, rss, sizeof(rss));
+        format_bytes(labs(change_kb) * 1024.0, growth, sizeof(growth));
+        render_print(0, 22, "Mappings of pid %d: %d | RSS %s, %s%s in %.1f min | %d created, %d removed",
+                     mapping_tracker.pid, mapping_tracker.count, rss, change_kb < 0 ? "-" : "+", growth,
+                     (mapping_tracker.sampled_ns - mapping_tracker.started_ns) / 60e9,
+                     mapping_tracker.created, mapping_tracker.removed);
+    } else if (fd_list.active) {
+        render_print(0, 22, "Descriptors of pid %d: %d", fd_list.pid, fd_list.count);
+        for (int kind = 0; kind < FD_KIND_COUNT; kind++) {
+            render_append(" | %s %d", fd_kind_name(kind), fd_list.kinds[kind]);
+        }
+    } else if (leak_view) {
+        render_print(0, 22, "Leak suspects: %d of %d processes | RSS growth over the last %.0f-%.0f min",
+                     leak_tracker.suspect_count, leak_tracker.count, LEAK_WINDOW_NS / 60e9,
+                     2 * LEAK_WINDOW_NS / 60e9);
+    } else if (aggregate_view) {
+        render_print(0, 22, "By %s | CPU %.1f%%", aggregate_key_title(aggregate_key), aggregates.total_cpu);
+        if (sample_fraction < 1.0) {
+            render_append(" +/- %.1f (95%%, %.0f%% sample)", aggregates.total_margin,
+                   sample_fraction * 100.0);
+        }
+    } else {
+        render_print(0, 22, "Sort: %s %s", columns[sort_key].title, sort_descending ? "desc" : "asc");
+        if (filter_text[0] != '\0' && prompt != PROMPT_FILTER) {
+            render_append("  Filter: %s", filter_text);
+        }
+        if (hide_kernel_threads) render_append("  Kernel threads hidden");
+        if (drill_view) {
+            render_append("  %s: %s [Esc]", aggregate_key_title(drill_by), aggregate_key_name(drill_by, drill_key));
+        }
+    }
+
+    /* After whatever the view put in the header, so neither covers the other */
+    if (survival_tasks) {
+        render_append("  ");
+        render_attron(ATTR_REVERSE);
+        render_append("%s", get_collect_stats()->truncated ? " SURVIVAL: TRUNCATED " : " SURVIVAL ");
+        render_attroff(ATTR_REVERSE);
+    }
+    render_print(0, max_x - strlen(time_str), "%s", time_str);
+    render_attroff(ATTR_PAIR(1) | ATTR_BOLD);
+    draw_state_histogram(1, max_x);
+    render_hline(2, 0, '-', max_x);
 }
 
 void draw_footer(void) {
-    int max_y;
-    max_y = getmaxy(stdscr);
-
-    attron(COLOR_PAIR(2));
-    mvprintw(max_y - 1, 0, "Keys: [Up/Down]Navigate | [q]uit | [d]ebug | [h]elp");
-    attroff(COLOR_PAIR(2));
-}
+    int footer_y = layout.footer_y;
 
-int is_numeric(char* str) {
-    if (*str == '\0') return 0;
-    while (*str != '\0') {
-        int is_digit_result = isdigit((unsigned char)*str);
-        if (!is_digit_result) {
-	    return 0;
-	}
-  	str++;
+    render_attron(ATTR_PAIR(2));
+    switch (prompt) {
+        case PROMPT_FILTER:
+            render_print(footer_y, 0, "Filter: %s_  [Enter]Apply | [Esc]Clear", filter_text);
+            break;
+        case PROMPT_JUMP:
+            render_print(footer_y, 0, "Jump to pid/tid: %s_  [Enter]Jump | [Esc]Cancel", jump_text);
+            break;
+        case PROMPT_SEARCH:
+            render_print(footer_y, 0, "Search: %s_  [Enter]Find | [Esc]Cancel", search_text);
+            break;
+        default:
+            if (status_text[0] != '\0') {
+                render_print(footer_y, 0, "%s", status_text);
+            } else if (profiler.active) {
+                render_print(footer_y, 0, "Profiling pid %d: [Up/Down/PgUp/PgDn]Scroll | [e]xport folded stacks | [p]Stop",
+                             profiler.pid);
+            } else if (mapping_tracker.active) {
+                if (mapping_tracker.error) {
+                    render_print(footer_y, 0, "Mappings of pid %d: %s | [v]Back", mapping_tracker.pid,
+                                 strerror(mapping_tracker.error));
+                } else {
+                    render_print(footer_y, 0, "Mappings of pid %d: read every %.0f s, %zu KB in %.1f ms | "
+                                 "[Up/Down/PgUp/PgDn]Scroll | [v]Back", mapping_tracker.pid, SMAPS_PERIOD_NS / 1e9,
+                                 mapping_tracker.bytes_read / 1024, mapping_tracker.parse_ns / 1e6);
+                }
+            } else if (fd_list.active) {
+                if (fd_list.error) {
+                    render_print(footer_y, 0, "Descriptors of pid %d: %s | [O]Back", fd_list.pid,
+                                 strerror(fd_list.error));
+                } else {
+                    render_print(footer_y, 0, "Descriptors of pid %d: listed every %.0f s in %.1f ms | "
+                                 "[Up/Down/PgUp/PgDn]Scroll | [O]Back", fd_list.pid, FD_LIST_PERIOD_NS / 1e9,
+                                 fd_list.list_ns / 1e6);
+                }
+            } else if (leak_view) {
+                render_print(footer_y, 0, "Leak suspects: [Up/Down/PgUp/PgDn]Select | [Enter]Show in task list | [l]Back");
+            } else if (drill_view && drill_by == AGGREGATE_BY_WAIT) {
+                if (kernel_stack_errno) {
+                    render_print(footer_y, 0, "Kernel stack: %s | [Esc]Back", strerror(kernel_stack_errno));
+                } else {
+                    render_print(footer_y, 0, "Kernel stack: %s | [Esc]Back", kernel_stack);
+                }
+            } else {
+                render_print(footer_y, 0, "Keys: [Up/Down/PgUp/PgDn/Home/End]Navigate | [g]oto pid | [/]search [n/N] | [</>]Sort | [I]nvert | [f]ilter | [m]emory | [i]o | [s]tates | [o]pen fds [O]list | [k]ernel threads | [a]ggregate | [u]sers | [w]ait | [l]eaks | [v]mappings | [p]rofile | [q]uit | [d]ebug");
+            }
+            break;
     }
-    return 1;
+    render_attroff(ATTR_PAIR(2));
 }
 
 /* ========== UI Helper Functions ========== */
 
 int get_state_color(char state) {
     switch(state) {
-        case 'R': return COLOR_PAIR(6);  /* Green for running */
-        case 'S': return COLOR_PAIR(7);  /* Blue for sleeping */
+        case 'R': return ATTR_PAIR(6);  /* Green for running */
+        case 'S': return ATTR_PAIR(7);  /* Blue for sleeping */
         default: return 0;
     }
 }
 
+/* Fixed-width columns use their own width; the fill column takes the rest */
+static int column_width(int column, int x, int max_x) {
+    int remaining = max_x - x - 1;
+    int width = columns[column].width ? columns[column].width : remaining;
+    return width < remaining ? width : remaining;
+}
+
+/*
+ * Tell the renderer how far the rows of a scrolling list moved since the last
+ * frame, so it can shift them on the terminal instead of repainting. Only
+ * valid while the same list is drawn at the same place and height.
+ */
+static void hint_scroll(int list, int top, int lines, int offset) {
+    static int drawn_list = -1;
+    static int drawn_top, drawn_lines, drawn_offset;
+
+    if (list == drawn_list && top == drawn_top && lines == drawn_lines && offset != drawn_offset) {
+        render_scroll(top, top + lines, offset - drawn_offset);
+    }
+    drawn_list = list;
+    drawn_top = top;
+    drawn_lines = lines;
+    drawn_offset = offset;
+}
+
+/* Per-command, per-user or per-wait-channel totals, busiest first; sampled
+ * estimates carry their margin, and wait channels get a bar of their threads */
+static void draw_aggregates(int top, int lines, int max_x) {
+    if (aggregate_selected >= aggregates.count) aggregate_selected = aggregates.count - 1;
+    if (aggregate_selected < 0) aggregate_selected = 0;
+    if (aggregate_selected < aggregate_scroll) aggregate_scroll = aggregate_selected;
+    if (aggregate_selected >= aggregate_scroll + lines) aggregate_scroll = aggregate_selected - lines + 1;
+    if (aggregate_scroll > aggregates.count - lines) aggregate_scroll = aggregates.count - lines;
+    if (aggregate_scroll < 0) aggregate_scroll = 0;
+    hint_scroll(1, top + 2, lines, aggregate_scroll);
+
+    int sampling = sample_fraction < 1.0;
+    int histogram = aggregate_key == AGGREGATE_BY_WAIT;
+    int most = aggregates.count > 0 ? aggregates.rows[0].tasks : 0;
+    enum { NAME_WIDTH = 20, NUMBER_WIDTH = 8 };
+
+    /* The bar starts two columns after the last number printed */
+    int numbers = sampling ? 4 : 2;
+    int bar_x = 2 + NAME_WIDTH + numbers * (1 + NUMBER_WIDTH) + 2;
+    int bar_width = max_x - bar_x - 1;
+
+    render_attron(ATTR_PAIR(3) | ATTR_BOLD);
+    render_print(top, 2, "%-*s %*s %*s", NAME_WIDTH, histogram ? "Wait channel" :
+                 aggregate_key == AGGREGATE_BY_USER ? "User" : "Command",
+                 NUMBER_WIDTH, "Tasks", NUMBER_WIDTH, "CPU%");
+    if (sampling) render_append(" %*s %*s", NUMBER_WIDTH, "+/-95%", NUMBER_WIDTH, "Sampled");
+    render_attroff(ATTR_PAIR(3) | ATTR_BOLD);
+    render_hline(top + 1, 0, '-', max_x);
+
+    for (int i = 0; i < lines && aggregate_scroll + i < aggregates.count; i++) {
+        const AggregateRow *row = &aggregates.rows[aggregate_scroll + i];
+        int selected = aggregate_scroll + i == aggregate_selected;
+        if (selected) {
+            render_attron(ATTR_PAIR(5) | ATTR_BOLD);
+            render_hline(top + 2 + i, 0, ' ', max_x);
+        }
+        render_print(top + 2 + i, 2, "%-*.*s %*d %*.1f", NAME_WIDTH, NAME_WIDTH,
+                     aggregate_key_name(aggregate_key, row->key), NUMBER_WIDTH, row->tasks,
+                     NUMBER_WIDTH, row->cpu);
+        if (sampling) render_append(" %*.1f %*d", NUMBER_WIDTH, row->cpu_margin, NUMBER_WIDTH, row->sampled);
+        if (histogram && most > 0 && bar_width > 0) {
+            int length = (int)((double)row->tasks / most * bar_width + 0.5);
+            render_hline(top + 2 + i, bar_x, '#', length > 0 ? length : 1);
+        }
+        if (selected) render_attroff(ATTR_PAIR(5) | ATTR_BOLD);
+    }
+}
+
+/* Functions of the profiled process, most samples on top of the stack first;
+ * Total% counts samples with the function anywhere on the stack */
+static void draw_profile(int top, int lines, int max_x) {
+    if (profile_scroll > profiler.order_count - lines) profile_scroll = profiler.order_count - lines;
+    if (profile_scroll < 0) profile_scroll = 0;
+    hint_scroll(2, top + 2, lines, profile_scroll);
+
+    int object_width = 24;
+    int function_width = max_x - 2 - 7 - 7 - 2 - object_width - 1;
+    if (function_width < 10) function_width = 10;
+
+    render_attron(ATTR_PAIR(3) | ATTR_BOLD);
+    render_print(top, 2, "%6s %6s  %-*s %s", "Self%", "Total%", function_width, "Function", "Object");
+    render_attroff(ATTR_PAIR(3) | ATTR_BOLD);
+    render_hline(top + 1, 0, '-', max_x);
+
+    double scale = profiler.samples ? 100.0 / profiler.samples : 0.0;
+    for (int i = 0; i < lines && profile_scroll + i < profiler.order_count; i++) {
+        int function = profiler.order[profile_scroll + i];
+        const ProfileRow *row = &profiler.rows[function];
+        render_print(top + 2 + i, 2, "%6.1f %6.1f  %-*.*s %.*s", row->self * scale, row->total * scale,
+                     function_width, function_width, intern_lookup(&profiler.functions, function),
+                     object_width, row->object >= 0 ? intern_lookup(&profiler.objects, row->object) : "?");
+    }
+}
+
+/* Processes whose RSS grows steadily, fastest first */
+static void draw_leaks(int top, int lines, int max_x) {
+    if (leak_selected >= leak_tracker.suspect_count) leak_selected = leak_tracker.suspect_count - 1;
+    if (leak_selected < 0) leak_selected = 0;
+    if (leak_selected < leak_scroll) leak_scroll = leak_selected;
+    if (leak_selected >= leak_scroll + lines) leak_scroll = leak_selected - lines + 1;
+    if (leak_scroll > leak_tracker.suspect_count - lines) leak_scroll = leak_tracker.suspect_count - lines;
+    if (leak_scroll < 0) leak_scroll = 0;
+    hint_scroll(3, top + 2, lines, leak_scroll);
+
+    render_attron(ATTR_PAIR(3) | ATTR_BOLD);
+    render_print(top, 2, "%-8s %-20s %8s %10s %6s %8s", "PID", "Command", "RSS", "Growth/h", "Fit", "Watched");
+    render_attroff(ATTR_PAIR(3) | ATTR_BOLD);
+    render_hline(top + 1, 0, '-', max_x);
+
+    if (leak_tracker.suspect_count == 0) {
+        render_print(top + 2, 2, "No process has grown steadily for %.0f minutes (RSS is read while the "
+                     "memory columns or this view are shown)", LEAK_MIN_SPAN_NS / 60e9);
+    }
+    for (int i = 0; i < lines && leak_scroll + i < leak_tracker.suspect_count; i++) {
+        const LeakEntry *entry = &leak_tracker.entries[leak_tracker.suspects[leak_scroll + i]];
+        int selected = leak_scroll + i == leak_selected;
+        if (selected) {
+            render_attron(ATTR_PAIR(5) | ATTR_BOLD);
+            render_hline(top + 2 + i, 0, ' ', max_x);
+        }
+
+        char rss[16];
+        char rate[16];
+        format_bytes(entry->rss, rss, sizeof(rss));
+        format_bytes(entry->rate, rate, sizeof(rate));
+        render_print(top + 2 + i, 2, "%-8d %-20.20s %8s %10s %6.2f %6.0f m", entry->pid,
+                     intern_lookup(&command_names, entry->command_id), rss, rate, entry->fit,
+                     leak_entry_span(entry) / 60.0);
+        if (selected) render_attroff(ATTR_PAIR(5) | ATTR_BOLD);
+    }
+}
+
+/* Mappings of the watched process, most growth since the first sample first */
+static void draw_mappings(int top, int lines, int max_x) {
+    if (mapping_scroll > mapping_tracker.count - lines) mapping_scroll = mapping_tracker.count - lines;
+    if (mapping_scroll < 0) mapping_scroll = 0;
+    hint_scroll(4, top + 2, lines, mapping_scroll);
+
+    render_attron(ATTR_PAIR(3) | ATTR_BOLD);
+    render_print(top, 2, "%-25s %8s %8s %9s %9s  %s", "Address range", "Size", "RSS", "Growth", "Last", "Name");
+    render_attroff(ATTR_PAIR(3) | ATTR_BOLD);
+    render_hline(top + 1, 0, '-', max_x);
+
+    for (int i = 0; i < lines && mapping_scroll + i < mapping_tracker.count; i++) {
+        const MappingSample *mapping = &mapping_tracker.mappings[mapping_tracker.order[mapping_scroll + i]];
+        long growth_kb = mapping_growth_kb(mapping);
+        char size[16];
+        char rss[16];
+        char growth[16];
+        char change[16];
+        format_bytes(mapping->end - mapping->start, size, sizeof(size));
+        format_bytes(mapping->rss_kb * 1024.0, rss, sizeof(rss));
+        format_bytes(labs(growth_kb) * 1024.0, growth, sizeof(growth));
+        format_bytes(labs(mapping->change_kb) * 1024.0, change, sizeof(change));
+
+        const char *name = intern_lookup(&mapping_tracker.names, mapping->name_id);
+        int color = growth_kb > 0 ? ATTR_PAIR(8) : 0;
+        render_attron(color);
+        render_print(top + 2 + i, 2, "%012llx-%012llx %8s %8s %c%8s %c%8s  %s",
+                     (unsigned long long)mapping->start, (unsigned long long)mapping->end, size, rss,
+                     growth_kb < 0 ? '-' : '+', growth, mapping->change_kb < 0 ? '-' : '+', change,
+                     name[0] ? name : "[anon]");
+        render_attroff(color);
+    }
+}
+
+/* Descriptors of the listed process, by number */
+static void draw_fds(int top, int lines, int max_x) {
+    if (fd_scroll > fd_list.count - lines) fd_scroll = fd_list.count - lines;
+    if (fd_scroll < 0) fd_scroll = 0;
+    hint_scroll(5, top + 2, lines, fd_scroll);
+
+    render_attron(ATTR_PAIR(3) | ATTR_BOLD);
+    render_print(top, 2, "%6s  %-6s  %s", "FD", "Kind", "Target");
+    render_attroff(ATTR_PAIR(3) | ATTR_BOLD);
+    render_hline(top + 1, 0, '-', max_x);
+
+    for (int i = 0; i < lines && fd_scroll + i < fd_list.count; i++) {
+        const FdEntry *entry = &fd_list.entries[fd_scroll + i];
+        render_print(top + 2 + i, 2, "%6d  %-6s  %s", entry->fd, fd_kind_name(entry->kind), entry->target);
+    }
+}
+
 void draw_content(void) {
-    int max_y, max_x;
-    getmaxyx(stdscr, max_y, max_x);
+    int max_x = layout.cols;
+    int available_lines = layout.list_lines;
+    int content_start_y = layout.list_top;
 
-    /* Calculate available space for task list */
-    int header_lines = 2;  /* Title + separator */
-    int footer_lines = 1;
-    int debug_lines = debug_mode ? 9 : 0;
-    int table_header_lines = 2;  /* Column headers + separator */
+    if (profiler.active) {
+        draw_profile(content_start_y, available_lines, max_x);
+        return;
+    }
+    if (mapping_tracker.active) {
+        draw_mappings(content_start_y, available_lines, max_x);
+        return;
+    }
+    if (fd_list.active) {
+        draw_fds(content_start_y, available_lines, max_x);
+        return;
+    }
+    if (leak_view) {
+        draw_leaks(content_start_y, available_lines, max_x);
+        return;
+    }
+    if (aggregate_view) {
+        draw_aggregates(content_start_y, available_lines, max_x);
+        return;
+    }
 
-    int available_lines = max_y - header_lines - footer_lines - debug_lines - table_header_lines;
-    int content_start_y = header_lines;
+    /* Keep the selection visible after a re-sort or resize moved it */
+    if (selected_index < scroll_offset) {
+        scroll_offset = selected_index;
+    } else if (available_lines > 0 && selected_index >= scroll_offset + available_lines) {
+        scroll_offset = selected_index - available_lines + 1;
+    }
+    if (scroll_offset > view_count - available_lines) scroll_offset = view_count - available_lines;
+    if (scroll_offset < 0) scroll_offset = 0;
 
-    /* Draw table header */
-    attron(COLOR_PAIR(3) | A_BOLD);
-    mvprintw(content_start_y, 2, "%-8s %-8s %-20s %-12s", "PID", "TID", "Command", "State");
-    attroff(COLOR_PAIR(3) | A_BOLD);
-    mvhline(content_start_y + 1, 0, '-', max_x);
+    /* Draw table header; the sort column is underlined */
+    render_attron(ATTR_PAIR(3) | ATTR_BOLD);
+    int x = 2;
+    for (int c = 0; c < COLUMN_COUNT && x < max_x - 1; c++) {
+        if (!columns[c].visible) continue;
+        int width = column_width(c, x, max_x);
+        if (c == (int)sort_key) render_attron(ATTR_UNDERLINE);
+        render_print(content_start_y, x, columns[c].right_align ? "%*.*s" : "%-*.*s",
+                 width, width, columns[c].title);
+        if (c == (int)sort_key) render_attroff(ATTR_UNDERLINE);
+        x += width + 1;
+    }
+    render_attroff(ATTR_PAIR(3) | ATTR_BOLD);
+    render_hline(content_start_y + 1, 0, '-', max_x);
 
     /* Draw task rows */
-    int table_start_y = content_start_y + table_header_lines;
+    int table_start_y = layout.table_top;
+    hint_scroll(0, table_start_y, available_lines, scroll_offset);
 
-    for (int i = 0; i < available_lines && (scroll_offset + i) < task_count; i++) {
+    for (int i = 0; i < available_lines && (scroll_offset + i) < view_count; i++) {
         int task_idx = scroll_offset + i;
-        TaskInfo *task = &tasks[task_idx];
+        TaskInfo *task = &snapshot->tasks[view_rows[task_idx]];
         int row_y = table_start_y + i;
+        int selected = task_idx == selected_index;
+
+        /* Tasks that just started or exited stand out for a tick */
+        int row_color = 0;
+        if (task->exited) {
+            row_color = ATTR_PAIR(8);
+        } else if (intmap_get(&highlight_tids, task->tid) == EVENT_BORN) {
+            row_color = ATTR_PAIR(6) | ATTR_BOLD;
+        }
 
         /* Highlight selected row */
-        if (task_idx == selected_index) {
-            attron(COLOR_PAIR(5) | A_BOLD);
-            mvhline(row_y, 0, ' ', max_x);  /* Fill entire row with background */
+        if (selected) {
+            render_attron(ATTR_PAIR(5) | ATTR_BOLD);
+            render_hline(row_y, 0, ' ', max_x);  /* Fill entire row with background */
         }
 
-        /* Draw task info */
-        mvprintw(row_y, 2, "%-8d %-8d %-20s", task->pid, task->tid, task->command);
+        /* Draw task info, clipped so nothing wraps onto the next line */
+        x = 2;
+        for (int c = 0; c < COLUMN_COUNT && x < max_x - 1; c++) {
+            if (!columns[c].visible) continue;
+            int width = column_width(c, x, max_x);
+            char cell[512];
+            format_column(task, c, cell, sizeof(cell));
 
-        /* Draw state with color (only if not selected, to maintain readability) */
-        if (task_idx == selected_index) {
-            mvprintw(row_y, 2 + 8 + 1 + 8 + 1 + 20 + 1, "%-12s", get_state_string(task->state));
-            attroff(COLOR_PAIR(5) | A_BOLD);
-        } else {
-            attron(get_state_color(task->state));
-            mvprintw(row_y, 2 + 8 + 1 + 8 + 1 + 20 + 1, "%-12s", get_state_string(task->state));
-            attroff(get_state_color(task->state));
+            /* Draw state with color (only if not selected, to maintain readability) */
+            int color = (c == COL_STATE && !selected) ? get_state_color(task->state) : 0;
+            if (row_color && !selected) color = row_color;
+
+            /* Values carried over from an earlier tick are dimmed */
+            if (column_is_stale(task, c, snapshot->taken_ns)) color |= ATTR_DIM;
+            render_attron(color);
+            render_print(row_y, x, columns[c].right_align ? "%*.*s" : "%-*.*s", width, width, cell);
+            render_attroff(color);
+            x += width + 1;
+        }
+
+        if (selected) {
+            render_attroff(ATTR_PAIR(5) | ATTR_BOLD);
         }
     }
 
     /* Draw scroll indicator if needed */
-    if (task_count > available_lines) {
+    if (view_count > available_lines) {
         int indicator_y = content_start_y + 3;
-        attron(COLOR_PAIR(3));
-        mvprintw(indicator_y, max_x - 15, "[%d/%d]", selected_index + 1, task_count);
-        attroff(COLOR_PAIR(3));
+        render_attron(ATTR_PAIR(3));
+        render_print(indicator_y, max_x - 15, "[%d/%d]", selected_index + 1, view_count);
+        render_attroff(ATTR_PAIR(3));
     }
 }
 
 void draw_debug_panel(void) {
     if (!debug_mode) return;
 
-    int max_y, max_x;
-    getmaxyx(stdscr, max_y, max_x);
-
-    int panel_height = 8;
-    int panel_top = max_y - panel_height - 1;
+    int max_x = layout.cols;
+    int panel_top = layout.debug_top;
 
-    attron(COLOR_PAIR(4) | A_BOLD);
-    mvhline(panel_top - 1, 0, '=', max_x);
-    mvprintw(panel_top - 1, 2, "[ DEBUG PANEL ]");
-    attroff(COLOR_PAIR(4) | A_BOLD);
+    render_attron(ATTR_PAIR(4) | ATTR_BOLD);
+    render_hline(panel_top - 1, 0, '=', max_x);
+    render_print(panel_top - 1, 2, "[ DEBUG PANEL ]");
+    render_attroff(ATTR_PAIR(4) | ATTR_BOLD);
 
-    attron(COLOR_PAIR(4));
-    mvprintw(panel_top,     2, "Signal Statistics:");
-    mvprintw(panel_top + 1, 4, "SIGWINCH received: %d times", resize_count);
-    mvprintw(panel_top + 2, 4, "resize_pending flag: %d", resize_pending);
+    render_attron(ATTR_PAIR(4));
+    render_print(panel_top,     2, "Signal Statistics:");
+    render_print(panel_top + 1, 4, "SIGWINCH received: %d times | re-layouts: %d",
+                 (int)sigwinch_count, layout_count);
+    render_print(panel_top + 2, 4, "resize_pending flag: %d", resize_pending);
 
-    mvprintw(panel_top + 3, 2, "select() Statistics:");
-    mvprintw(panel_top + 4, 4, "Timeouts: %d | Input events: %d | Interrupts (EINTR): %d",
-             select_timeout_count, select_input_count, select_interrupt_count);
+    render_print(panel_top + 3, 2, "select() Statistics:");
+    render_print(panel_top + 4, 4, "Timeouts: %d | Input events: %d | Interrupts (EINTR): %d | Keys coalesced: %d",
+             select_timeout_count, select_input_count, select_interrupt_count, coalesced_key_count);
 
-    mvprintw(panel_top + 5, 2, "Last Error:");
-    mvprintw(panel_top + 6, 4, "errno = %d (%s)",
+    render_print(panel_top + 5, 2, "Last Error:");
+    render_print(panel_top + 6, 4, "errno = %d (%s)",
              last_errno, last_errno == EINTR ? "EINTR - Interrupted by signal" :
                         last_errno == 0 ? "No error" : "Other");
-    attroff(COLOR_PAIR(4));
+
+    render_print(panel_top + 7, 2, "Sort: %d rows in %.3f ms | displaced: %d | fallbacks: %d",
+             view_count, last_sort_ns / 1e6, sort_engine.last_displaced,
+             sort_engine.fallback_count);
+
+    SnapshotStats stats;
+    snapshot_get_stats(&stats);
+    render_print(panel_top + 8, 2, "Arena: %zu KB used | high-water %zu KB | %zu KB reserved | snapshots: %d (%d pooled)",
+             stats.arena_used / 1024, stats.arena_high_water / 1024, stats.arena_reserved / 1024,
+             stats.allocated, stats.free);
+
+    CmdlineCacheStats cache_stats;
+    get_cmdline_cache_stats(&cache_stats);
+    UserCacheStats user_stats;
+    user_cache_get_stats(&user_stats);
+    render_print(panel_top + 9, 2, "Cmdline cache: %d processes | hits: %lu | reads: %lu | evicted: %lu",
+             cache_stats.entries, cache_stats.hits, cache_stats.misses, cache_stats.evictions);
+    render_append(" | Users: %d passwd, %d NSS, %d pending, %d unknown | passwd reloads: %lu",
+                  user_stats.from_passwd, user_stats.from_nss, user_stats.pending, user_stats.unknown,
+                  user_stats.reloads);
+
+    /* Collection plan: what the visible columns, sort and filter need */
+    render_print(panel_top + 10, 2, "Plan fields:");
+    for (int field = 0; field < FIELD_COUNT; field++) {
+        if (collect_plan.fields & FIELD_BIT(field)) render_append(" %s", field_name(field));
+    }
+    const CollectStats *collect = get_collect_stats();
+    render_print(panel_top + 11, 2, "Plan files (every N ticks: read/failed/carried):");
+    for (int source = 0; source < SOURCE_COUNT; source++) {
+        if (collect_plan.sources & SOURCE_BIT(source)) {
+            render_append(" %s %d: %d/%d/%d", source_name(source), collect_plan.periods[source],
+                   collect->reads[source], collect->failed[source], collect->carried[source]);
+        } else {
+            render_append(" [%s skipped]", source_name(source));
+        }
+    }
+    render_append(" | schedstat: %d", collect->schedstat_reads);
+    render_print(panel_top + 12, 2, "Schedule: %d priority | %d background | %d waiting their turn | ",
+             collect->priority, collect->background, collect->deferred);
+    if (sample_fraction < 1.0) {
+        render_append("sample: %.0f%%", sample_fraction * 100.0);
+    } else if (read_budget > 0) {
+        render_append("budget: %d reads", read_budget);
+    } else {
+        render_append("budget: no limit");
+    }
+    render_append(" | kernel threads: %d, %d file reads saved", collect->kernel_threads,
+                  collect->kernel_reads_saved);
+
+    const SurvivalStatus *survival = survival_status();
+    if (survival->active) {
+        render_print(panel_top + 13, 2, "Survival: %s %d | memory %s | %d tasks reserved | refresh every %.0f ms%s",
+                 priority_name(survival->priority), survival->priority_value,
+                 survival->locked ? "locked" : strerror(survival->lock_errno), survival_tasks,
+                 refresh_interval_ns / 1e6, collect->truncated ? " | TRUNCATED" : "");
+    } else {
+        render_print(panel_top + 13, 2, "Survival: off (-S tasks)");
+    }
+
+    render_print(panel_top + 14, 2, "Changes:");
+    for (int kind = 0; kind < EVENT_KIND_COUNT; kind++) {
+        render_append(" %s %d |", change_kind_name(kind), diff_engine.counts[kind]);
+    }
+    render_append(" diff %.3f ms%s", diff_engine.last_ns / 1e6,
+                  diff_engine.last_sorted ? " (table was out of order)" : "");
+
+    render_print(panel_top + 15, 2, "Plugins:");
+    if (plugin_column_count() == 0) render_append(" none (-P plugin.so)");
+    for (int i = 0; i < plugin_column_count(); i++) {
+        const PluginColumnStats *plugin = plugin_column_stats(i);
+        render_append(" %s %.3f ms (avg %.3f) |", plugin->name, plugin->last_ns / 1e6,
+                      plugin->calls ? plugin->total_ns / 1e6 / plugin->calls : 0.0);
+    }
+
+    if (profiler.active) {
+        SymbolCacheStats symbols;
+        symbol_cache_get_stats(&symbols);
+        render_print(panel_top + 16, 2, "Profiler: drain %.3f ms | %d functions, %d stacks (%lu dropped) | "
+                     "symbols: %d files, %ld functions, %zu KB mapped | lookups %lu, unmapped %lu, maps reads %lu",
+                     profiler.drain_ns / 1e6, profiler.functions.count, profiler.stacks.count,
+                     profiler.dropped_stacks, symbols.images, symbols.functions, symbols.mapped_bytes / 1024,
+                     profiler.symbols.lookups, profiler.symbols.unmapped, profiler.symbols.reloads);
+    } else {
+        render_print(panel_top + 16, 2, "Profiler: off ([p] on the selected process)");
+    }
+
+    const RenderStats *render = render_stats();
+    render_print(panel_top + 17, 2, "Render: %s | last frame %.3f ms", backend_name(render_backend),
+                 render->last_frame_ns / 1e6);
+    if (render_backend == BACKEND_ANSI) {
+        render_append(" | %zu bytes | region scrolls: %lu | synchronized output %s",
+                      render->last_frame_bytes, render->scrolls,
+                      render->synchronized ? "on" : "not supported");
+    }
+    render_attroff(ATTR_PAIR(4));
 }
 
 void draw_ui(void) {
-    clear();
+    render_erase();
     draw_header();
     draw_content();
     draw_debug_panel();
     draw_footer();
-    refresh();
+    render_present();
+}
+
+/* ========== View Ordering ========== */
+
+static int reserve_view(int count) {
+    if (count <= view_capacity) return 0;
+    if (heap_frozen) return -1;
+
+    int new_capacity = view_capacity ? view_capacity : 1024;
+    while (new_capacity < count) new_capacity *= 2;
+
+    int *rows = realloc(view_rows, new_capacity * sizeof(int));
+    if (!rows) return -1;
+    view_rows = rows;
+
+    int *prev_rows = realloc(prev_view_rows, new_capacity * sizeof(int));
+    if (!prev_rows) return -1;
+    prev_view_rows = prev_rows;
+
+    unsigned char *placed = realloc(row_placed, new_capacity);
+    if (!placed) return -1;
+    row_placed = placed;
+
+    int *pos = realloc(view_pos, new_capacity * sizeof(int));
+    if (!pos) return -1;
+    view_pos = pos;
+
+    view_capacity = new_capacity;
+    return 0;
+}
+
+/* Filter matching works on the cached command line; nothing is re-read */
+static int task_matches(const TaskInfo *task) {
+    if (hide_kernel_threads && task->kernel_thread) return 0;
+    if (drill_view && !aggregate_task_matches(drill_by, drill_key, task)) return 0;
+    if (filter_text[0] == '\0') return 1;
+    return strstr(task->command, filter_text) != NULL ||
+           strstr(task->cmdline, filter_text) != NULL;
+}
+
+/* Rebuild view_pos after view_rows changed */
+static void index_view(void) {
+    memset(view_pos, 0xff, snapshot->count * sizeof(int));
+    for (int i = 0; i < view_count; i++) {
+        view_pos[view_rows[i]] = i;
+    }
+}
+
+/* Returns: the line showing tid, through the tid index; -1 if it is gone or filtered out */
+static int view_line_of_tid(int tid) {
+    int row = snapshot_find_tid(snapshot, tid);
+    return row < 0 ? -1 : view_pos[row];
+}
+
+/* Move the selection to the line showing tid, if it is still there */
+static void select_tid(int tid) {
+    int line = view_line_of_tid(tid);
+    if (line >= 0) selected_index = line;
+    if (selected_index >= view_count) {
+        selected_index = view_count > 0 ? view_count - 1 : 0;
+    }
+}
+
+/*
+ * Start the view from the previous frame's order: surviving tasks keep
+ * their old position, new ones go at the end. The adaptive re-sort then
+ * only has to move the rows whose key actually changed.
+ * Returns: number of rows placed, or -1 on allocation failure
+ */
+static int seed_from_previous_order(void) {
+    TaskInfo *tasks = snapshot->tasks;
+    int task_count = snapshot->count;
+
+    memset(row_placed, 0, task_count);
+
+    int count = 0;
+    for (int i = 0; i < prev_view_count; i++) {
+        int row = snapshot_find_tid(snapshot, prev_snapshot->tasks[prev_view_rows[i]].tid);
+        if (row >= 0 && !row_placed[row]) {
+            row_placed[row] = 1;
+            if (task_matches(&tasks[row])) view_rows[count++] = row;
+        }
+    }
+    for (int i = 0; i < task_count; i++) {
+        if (!row_placed[i] && task_matches(&tasks[i])) view_rows[count++] = i;
+    }
+    return count;
+}
+
+/* Matching rows in collection order. Returns: the number of rows */
+static int filter_rows(void) {
+    int count = 0;
+    for (int i = 0; i < snapshot->count; i++) {
+        if (task_matches(&snapshot->tasks[i])) view_rows[count++] = i;
+    }
+    return count;
+}
+
+/*
+ * Fully re-sort the current snapshot, e.g. after the sort column changed.
+ * The selection follows the selected task rather than staying on the same line.
+ */
+void rebuild_view(void) {
+    if (!snapshot) return;
+    int tid = selected_index < view_count ? snapshot->tasks[view_rows[selected_index]].tid : -1;
+
+    uint64_t sort_start = monotonic_ns();
+    view_count = filter_rows();
+    sort_rows(&sort_engine, snapshot->tasks, view_rows, view_count, sort_key, sort_descending);
+    last_sort_ns = monotonic_ns() - sort_start;
+
+    index_view();
+    select_tid(tid);
+}
+
+/*
+ * The tasks that must be fresh every tick: the rows on screen (the selection
+ * is always one of them) and, while filtering, every match. While sampling,
+ * the busiest tasks of the last round are read exactly as well.
+ * Returns: -1 on allocation failure
+ */
+static int build_priority_set(void) {
+    int first = 0;
+    int last = 0;
+    /* Wait channels are only read for blocked and watched threads, so the
+     * wait view watches whatever the filter matches */
+    int watch_matches = aggregate_view && aggregate_key == AGGREGATE_BY_WAIT && filter_text[0] != '\0';
+    if (snapshot && watch_matches) {
+        last = view_count;
+    } else if (snapshot && !aggregate_view) {
+        first = filter_text[0] != '\0' ? 0 : scroll_offset;
+        last = filter_text[0] != '\0' ? view_count : scroll_offset + layout.list_lines;
+        if (last > view_count) last = view_count;
+    }
+
+    int top_tids[TOP_CONTRIBUTORS];
+    int top_count = 0;
+    if (snapshot && sample_fraction < 1.0) {
+        top_count = find_top_contributors(snapshot, top_tids, TOP_CONTRIBUTORS);
+    }
+
+    if (intmap_reset(&priority_tids, last - first + top_count) < 0) return -1;
+    for (int i = first; i < last; i++) {
+        intmap_put(&priority_tids, snapshot->tasks[view_rows[i]].tid, 1);
+    }
+    for (int i = 0; i < top_count; i++) {
+        intmap_put(&priority_tids, top_tids[i], 1);
+    }
+
+    int watch_waits = snapshot && filter_text[0] != '\0' &&
+                      ((aggregate_view && aggregate_key == AGGREGATE_BY_WAIT) ||
+                       (drill_view && drill_by == AGGREGATE_BY_WAIT));
+    if (intmap_reset(&wait_tids, watch_waits ? view_count : 0) < 0) return -1;
+    for (int i = 0; watch_waits && i < view_count; i++) {
+        intmap_put(&wait_tids, snapshot->tasks[view_rows[i]].tid, 1);
+    }
+    return 0;
+}
+
+/* Change stream subscriber: remember who was born or died for drawing */
+static void note_birth_or_death(const ChangeEvent *event, const Snapshot *prev,
+                                const Snapshot *next, void *context) {
+    (void)prev;
+    (void)next;
+    (void)context;
+
+    /* A reused tid comes as died then born; only the new task is shown */
+    if (event->kind == EVENT_BORN && highlight_count > 0 &&
+        highlights[highlight_count - 1].tid == event->tid) {
+        highlight_count--;
+    }
+    if (highlight_count == MAX_HIGHLIGHTS) return;
+    highlights[highlight_count].tid = event->tid;
+    highlights[highlight_count].row = event->row;
+    highlights[highlight_count].kind = event->kind;
+    highlight_count++;
+}
+
+/*
+ * Copy this tick's dead tasks from prev into next, marked exited, so their
+ * rows are shown dying for a tick. They are left out of the tid index and
+ * are dropped for good at the next refresh.
+ */
+static void add_exited_rows(const Snapshot *prev, Snapshot *next) {
+    for (int i = 0; i < highlight_count; i++) {
+        if (highlights[i].kind != EVENT_DIED) continue;
+
+        const TaskInfo *old = &prev->tasks[highlights[i].row];
+        TaskInfo *ghost = snapshot_add_task(next);
+        if (!ghost) break;
+        *ghost = *old;
+        ghost->exited = 1;
+        ghost->cmdline = arena_strndup(&next->arena, old->cmdline, 4096);
+        if (!ghost->cmdline) ghost->cmdline = "";
+        for (int slot = 0; slot < MAX_PLUGIN_COLUMNS; slot++) {
+            if (plugin_value_types[slot] != PLUGIN_TEXT || !old->plugin_values[slot].text) continue;
+            ghost->plugin_values[slot].text = arena_strndup(&next->arena, old->plugin_values[slot].text, 256);
+        }
+    }
+
+    if (intmap_reset(&highlight_tids, highlight_count) < 0) return;
+    for (int i = 0; i < highlight_count; i++) {
+        intmap_put(&highlight_tids, highlights[i].tid, highlights[i].kind);
+    }
+}
+
+/* Recount the aggregate view for the current snapshot */
+static void update_aggregates(void) {
+    if (!snapshot) return;
+    aggregate_tasks(&aggregates, aggregate_key, snapshot, prev_snapshot, &priority_tids, sample_fraction);
+}
+
+/* Collect a new snapshot and re-sort it starting from the current order */
+void refresh_data(void) {
+    last_refresh_ns = monotonic_ns();
+
+    collect_plan = plan_collection(sort_key, filter_text[0] != '\0');
+    if ((aggregate_view && aggregate_key == AGGREGATE_BY_USER) || (drill_view && drill_by == AGGREGATE_BY_USER)) {
+        plan_add_column(&collect_plan, COL_USER);
+    }
+    if ((aggregate_view && aggregate_key == AGGREGATE_BY_WAIT) || (drill_view && drill_by == AGGREGATE_BY_WAIT)) {
+        plan_add_column(&collect_plan, COL_WCHAN);
+    }
+    if (leak_view) plan_add_column(&collect_plan, COL_RSS);
+    if (build_priority_set() < 0) return;
+    CollectSchedule schedule = {&priority_tids, &wait_tids, read_budget, sample_fraction, refresh_interval_ns};
+
+    Snapshot *next = snapshot_acquire();
+    if (!next) return;
+    if (collect_task_data(next, snapshot, &collect_plan, &schedule) < 0 || snapshot_build_index(next) < 0 ||
+        reserve_view(next->count) < 0) {
+        snapshot_release(next);
+        return;
+    }
+    compute_task_rates(next, snapshot);
+    leak_tracker_update(&leak_tracker, next);
+    state_totals(next, state_window);
+    plugins_fill(next);
+
+    highlight_count = 0;
+    diff_snapshots(&diff_engine, snapshot, next);
+    add_exited_rows(snapshot, next);
+    if (reserve_view(next->count) < 0) {
+        snapshot_release(next);
+        return;
+    }
+
+    int tid = -1;
+    if (snapshot && selected_index < view_count) {
+        tid = snapshot->tasks[view_rows[selected_index]].tid;
+    }
+
+    /* The old previous snapshot goes back to the pool; its arena resets in O(1) */
+    snapshot_release(prev_snapshot);
+    prev_snapshot = snapshot;
+    snapshot = next;
+
+    int *swap = prev_view_rows;
+    prev_view_rows = view_rows;
+    view_rows = swap;
+    prev_view_count = prev_snapshot ? view_count : 0;
+
+    uint64_t sort_start = monotonic_ns();
+    int seeded = prev_view_count > 0 ? seed_from_previous_order() : -1;
+    if (seeded >= 0) {
+        view_count = seeded;
+        sort_rows_adaptive(&sort_engine, snapshot->tasks, view_rows, view_count,
+                           sort_key, sort_descending);
+    } else {
+        view_count = filter_rows();
+        sort_rows(&sort_engine, snapshot->tasks, view_rows, view_count, sort_key, sort_descending);
+    }
+    last_sort_ns = monotonic_ns() - sort_start;
+
+    index_view();
+    select_tid(tid);
+    if (aggregate_view) update_aggregates();
+
+    /* Where in the kernel the selected thread waits; one file, and only root may read it */
+    kernel_stack[0] = '\0';
+    kernel_stack_errno = 0;
+    if (drill_view && drill_by == AGGREGATE_BY_WAIT && selected_index < view_count) {
+        const TaskInfo *task = &snapshot->tasks[view_rows[selected_index]];
+        if (read_kernel_stack(task->pid, task->tid, kernel_stack, sizeof(kernel_stack)) < 0) {
+            kernel_stack_errno = errno;
+        }
+    }
+
+    /* Samples the kernel queued since the last tick; never waits for more */
+    profiler_drain(&profiler);
+    mapping_tracker_poll(&mapping_tracker);
+    fd_list_poll(&fd_list);
+
+    /* Survival mode: stretch the interval so collecting stays within its share */
+    if (survival_tasks) {
+        uint64_t cost = monotonic_ns() - last_refresh_ns;
+        uint64_t stretched = cost * 100 / SURVIVAL_DUTY_PERCENT;
+        refresh_interval_ns = stretched > REFRESH_INTERVAL_NS ? stretched : REFRESH_INTERVAL_NS;
+    }
+}
+
+/*
+ * Size everything the collector and renderer use for survival_tasks tasks,
+ * then lock it in memory. From here on nothing grows: a host with more tasks
+ * shows the first survival_tasks of them.
+ * Returns: -1 if the reservation itself could not be allocated
+ */
+static int enter_survival_mode(void) {
+    /* Current and previous snapshot, plus the one being collected */
+    if (snapshot_pool_reserve(3, survival_tasks, (size_t)survival_tasks * 64) < 0 ||
+        reserve_view(survival_tasks) < 0 ||
+        sort_engine_reserve(&sort_engine, survival_tasks) < 0 ||
+        intmap_reset(&priority_tids, survival_tasks) < 0 ||
+        intmap_reset(&wait_tids, survival_tasks) < 0 ||
+        intern_reserve(&command_names, SURVIVAL_COMMANDS, 16) < 0 ||
+        intern_reserve(&wait_channels, SURVIVAL_WAIT_CHANNELS, 24) < 0 ||
+        user_cache_reserve(SURVIVAL_USERS) < 0 ||
+        aggregates_reserve(&aggregates, SURVIVAL_COMMANDS) < 0 ||
+        leak_tracker_reserve(&leak_tracker, survival_tasks) < 0 ||
+        diff_engine_reserve(&diff_engine, survival_tasks) < 0 ||
+        intmap_reset(&highlight_tids, MAX_HIGHLIGHTS) < 0) {
+        return -1;
+    }
+
+    survival_enter();
+    return 0;
 }
 
 /* ========== Input Handling ========== */
 
+/* Show totals by key, or go back to the task list if they are already showing */
+static void toggle_aggregates(AggregateKey key) {
+    if (aggregate_view && aggregate_key == key) {
+        aggregate_view = 0;
+        return;
+    }
+    aggregate_view = 1;
+    leak_view = 0;
+    aggregate_key = key;
+    aggregate_scroll = 0;
+    aggregate_selected = 0;
+
+    /* The plan may not have included uids or wait channels before */
+    if ((key == AGGREGATE_BY_USER && !(collect_plan.fields & FIELD_BIT(FIELD_UID))) ||
+        (key == AGGREGATE_BY_WAIT && !(collect_plan.fields & FIELD_BIT(FIELD_WCHAN)))) {
+        refresh_data();
+    } else {
+        update_aggregates();
+    }
+}
+
+/* The profiler, mapping tracker and descriptor list each take over the
+ * screen for one process; opening one closes the others */
+static void close_process_views(void) {
+    profiler_stop(&profiler);
+    mapping_tracker_stop(&mapping_tracker);
+    fd_list_close(&fd_list);
+}
+
+/* Profile the process of the selected task, or stop profiling */
+static void toggle_profiler(void) {
+    if (profiler.active) {
+        profiler_stop(&profiler);
+        return;
+    }
+    if (aggregate_view || leak_view || selected_index >= view_count) {
+        snprintf(status_text, sizeof(status_text), "Select a task to profile");
+        return;
+    }
+
+    int pid = snapshot->tasks[view_rows[selected_index]].pid;
+    close_process_views();
+    if (profiler_start(&profiler, pid) < 0) {
+        snprintf(status_text, sizeof(status_text), "Cannot profile pid %d: %s", pid,
+                 errno == EACCES ? "perf_event_paranoid or permissions forbid it" : strerror(errno));
+        return;
+    }
+    profile_scroll = 0;
+}
+
+/* Watch the mappings of the selected task's process, or stop watching */
+static void toggle_mappings(void) {
+    if (mapping_tracker.active) {
+        mapping_tracker_stop(&mapping_tracker);
+        return;
+    }
+    if (aggregate_view || leak_view || selected_index >= view_count) {
+        snprintf(status_text, sizeof(status_text), "Select a task to watch the mappings of");
+        return;
+    }
+
+    int pid = snapshot->tasks[view_rows[selected_index]].pid;
+    close_process_views();
+    if (mapping_tracker_start(&mapping_tracker, pid) < 0) {
+        snprintf(status_text, sizeof(status_text), "Cannot read the mappings of pid %d: %s", pid, strerror(errno));
+        return;
+    }
+    mapping_scroll = 0;
+}
+
+/* List the descriptors of the selected task's process, or go back */
+static void toggle_fd_list(void) {
+    if (fd_list.active) {
+        fd_list_close(&fd_list);
+        return;
+    }
+    if (aggregate_view || leak_view || selected_index >= view_count) {
+        snprintf(status_text, sizeof(status_text), "Select a task to list the descriptors of");
+        return;
+    }
+
+    int pid = snapshot->tasks[view_rows[selected_index]].pid;
+    close_process_views();
+    if (fd_list_open(&fd_list, pid) < 0) {
+        snprintf(status_text, sizeof(status_text), "Cannot list the descriptors of pid %d: %s", pid, strerror(errno));
+        return;
+    }
+    fd_scroll = 0;
+}
+
+/* Write the folded stacks to pel-<pid>.folded in the current directory */
+static void export_profile(void) {
+    char path[32];
+    snprintf(path, sizeof(path), "pel-%d.folded", profiler.pid);
+    int stacks = profiler_export_folded(&profiler, path);
+    if (stacks < 0) {
+        snprintf(status_text, sizeof(status_text), "Cannot write %s: %.30s", path, strerror(errno));
+    } else {
+        snprintf(status_text, sizeof(status_text), "Wrote %d stacks to %s", stacks, path);
+    }
+}
+
+/* Show the leak suspects, or go back to the task list */
+static void toggle_leaks(void) {
+    leak_view = !leak_view;
+    aggregate_view = 0;
+    leak_scroll = 0;
+    leak_selected = 0;
+
+    /* The plan may not have included RSS before */
+    if (leak_view && !(collect_plan.fields & FIELD_BIT(FIELD_MEMORY))) refresh_data();
+}
+
+/* Open the task list on the tasks of the selected aggregate row */
+static void drill_down(void) {
+    if (aggregate_selected >= aggregates.count) return;
+    drill_view = 1;
+    drill_by = aggregate_key;
+    drill_key = aggregates.rows[aggregate_selected].key;
+    aggregate_view = 0;
+    selected_index = 0;
+    scroll_offset = 0;
+    refresh_data();
+}
+
+/* Next visible, sortable column in the given direction */
+static ColumnId next_sort_column(int step) {
+    int column = sort_key;
+    for (int i = 0; i < COLUMN_COUNT; i++) {
+        column = (column + step + COLUMN_COUNT) % COLUMN_COUNT;
+        if (columns[column].visible && columns[column].sortable) break;
+    }
+    return column;
+}
+
+typedef enum {
+    EDIT_IGNORED,
+    EDIT_CHANGED,
+    EDIT_DONE,       /* Enter */
+    EDIT_CANCELLED   /* Escape; the text is cleared */
+} EditResult;
+
+/* Apply one key to a prompt's text */
+static EditResult edit_line(char *text, size_t size, int ch) {
+    size_t len = strlen(text);
+
+    switch (ch) {
+        case '\n':
+        case '\r':
+        case KEY_ENTER:
+            return EDIT_DONE;
+
+        case 27:  /* Escape */
+            text[0] = '\0';
+            return EDIT_CANCELLED;
+
+        case KEY_BACKSPACE:
+        case 127:
+        case '\b':
+            if (len == 0) return EDIT_IGNORED;
+            text[len - 1] = '\0';
+            return EDIT_CHANGED;
+
+        default:
+            if (ch < 32 || ch > 126 || len + 1 >= size) return EDIT_IGNORED;
+            text[len] = (char)ch;
+            text[len + 1] = '\0';
+            return EDIT_CHANGED;
+    }
+}
+
+/* Keys typed while the filter prompt is open; the view updates as you type */
+static void handle_filter_input(int ch) {
+    EditResult result = edit_line(filter_text, sizeof(filter_text), ch);
+    if (result == EDIT_IGNORED) return;
+    if (result != EDIT_CHANGED) prompt = PROMPT_NONE;
+    if (result == EDIT_DONE) return;
+
+    /* The plan may not have included command lines before the filter was set */
+    if (filter_text[0] != '\0' && !(collect_plan.fields & FIELD_BIT(FIELD_CMDLINE))) {
+        refresh_data();
+    } else {
+        rebuild_view();
+    }
+}
+
+/* Select the line at index, clamped to the view; scroll so it sits mid-screen */
+static void jump_to_line(int index, int lines) {
+    if (index >= view_count) index = view_count - 1;
+    if (index < 0) index = 0;
+    selected_index = index;
+    scroll_offset = index - lines / 2;  /* draw_content() clamps this */
+}
+
+/* Select tid, or the process with that pid (its main thread has tid == pid) */
+static void jump_to_tid(int tid, int lines) {
+    int line = snapshot ? view_line_of_tid(tid) : -1;
+    if (line >= 0) {
+        jump_to_line(line, lines);
+    } else if (snapshot && snapshot_find_tid(snapshot, tid) >= 0) {
+        snprintf(status_text, sizeof(status_text), "Task %d is hidden by the filter", tid);
+    } else {
+        snprintf(status_text, sizeof(status_text), "No task %d", tid);
+    }
+}
+
+static int task_matches_search(const TaskInfo *task) {
+    return strstr(task->command, search_text) != NULL ||
+           strstr(task->cmdline, search_text) != NULL;
+}
+
+/*
+ * Select the nearest match of search_text from start in direction step,
+ * wrapping around. Cost grows with the distance to the match, not with any
+ * other navigation.
+ */
+static void search_from(int start, int step, int lines) {
+    if (search_text[0] == '\0' || view_count == 0) return;
+
+    int line = (start % view_count + view_count) % view_count;
+    for (int i = 0; i < view_count; i++) {
+        if (task_matches_search(&snapshot->tasks[view_rows[line]])) {
+            jump_to_line(line, lines);
+            return;
+        }
+        line += step;
+        if (line == view_count) line = 0;
+        if (line < 0) line = view_count - 1;
+    }
+    snprintf(status_text, sizeof(status_text), "No match for \"%s\"", search_text);
+}
+
+static void handle_jump_input(int ch, int lines) {
+    /* Only digits go into the pid */
+    if (ch >= 32 && ch <= 126 && !isdigit(ch)) return;
+
+    EditResult result = edit_line(jump_text, sizeof(jump_text), ch);
+    if (result == EDIT_DONE || result == EDIT_CANCELLED) prompt = PROMPT_NONE;
+    if (result == EDIT_DONE && jump_text[0] != '\0') jump_to_tid(atoi(jump_text), lines);
+}
+
+static void handle_search_input(int ch, int lines) {
+    EditResult result = edit_line(search_text, sizeof(search_text), ch);
+    if (result == EDIT_DONE || result == EDIT_CANCELLED) prompt = PROMPT_NONE;
+    if (result == EDIT_DONE) search_from(selected_index, 1, lines);
+}
+
 void handle_input(int ch) {
-    int max_y;
-    max_y = getmaxy(stdscr);
+    if (prompt == PROMPT_FILTER) {
+        handle_filter_input(ch);
+        return;
+    }
+    status_text[0] = '\0';
+
+    int available_lines = layout.list_lines;
+    int page = available_lines > 1 ? available_lines : 1;
 
-    /* Calculate visible lines for scrolling */
-    int header_lines = 2;
-    int footer_lines = 1;
-    int debug_lines = debug_mode ? 9 : 0;
-    int table_header_lines = 2;
-    int available_lines = max_y - header_lines - footer_lines - debug_lines - table_header_lines;
+    if (prompt == PROMPT_JUMP) {
+        handle_jump_input(ch, available_lines);
+        return;
+    }
+    if (prompt == PROMPT_SEARCH) {
+        handle_search_input(ch, available_lines);
+        return;
+    }
+
+    /* The profile table scrolls; draw_profile() clamps it */
+    if (profiler.active && (ch == KEY_UP || ch == KEY_DOWN || ch == KEY_PPAGE || ch == KEY_NPAGE ||
+                            ch == KEY_HOME || ch == KEY_END)) {
+        switch (ch) {
+            case KEY_UP:    profile_scroll--; break;
+            case KEY_DOWN:  profile_scroll++; break;
+            case KEY_PPAGE: profile_scroll -= page; break;
+            case KEY_NPAGE: profile_scroll += page; break;
+            case KEY_HOME:  profile_scroll = 0; break;
+            case KEY_END:   profile_scroll = profiler.order_count; break;
+        }
+        return;
+    }
+    if (mapping_tracker.active && (ch == KEY_UP || ch == KEY_DOWN || ch == KEY_PPAGE || ch == KEY_NPAGE ||
+                                   ch == KEY_HOME || ch == KEY_END)) {
+        switch (ch) {
+            case KEY_UP:    mapping_scroll--; break;
+            case KEY_DOWN:  mapping_scroll++; break;
+            case KEY_PPAGE: mapping_scroll -= page; break;
+            case KEY_NPAGE: mapping_scroll += page; break;
+            case KEY_HOME:  mapping_scroll = 0; break;
+            case KEY_END:   mapping_scroll = mapping_tracker.count; break;
+        }
+        return;
+    }
+    if (fd_list.active && (ch == KEY_UP || ch == KEY_DOWN || ch == KEY_PPAGE || ch == KEY_NPAGE ||
+                           ch == KEY_HOME || ch == KEY_END)) {
+        switch (ch) {
+            case KEY_UP:    fd_scroll--; break;
+            case KEY_DOWN:  fd_scroll++; break;
+            case KEY_PPAGE: fd_scroll -= page; break;
+            case KEY_NPAGE: fd_scroll += page; break;
+            case KEY_HOME:  fd_scroll = 0; break;
+            case KEY_END:   fd_scroll = fd_list.count; break;
+        }
+        return;
+    }
+    if (profiler.active && ch == 'e') {
+        export_profile();
+        return;
+    }
+
+    /* The leak view moves its selection; draw_leaks() clamps it */
+    if (leak_view && (ch == KEY_UP || ch == KEY_DOWN || ch == KEY_PPAGE || ch == KEY_NPAGE ||
+                      ch == KEY_HOME || ch == KEY_END)) {
+        switch (ch) {
+            case KEY_UP:    leak_selected--; break;
+            case KEY_DOWN:  leak_selected++; break;
+            case KEY_PPAGE: leak_selected -= page; break;
+            case KEY_NPAGE: leak_selected += page; break;
+            case KEY_HOME:  leak_selected = 0; break;
+            case KEY_END:   leak_selected = leak_tracker.suspect_count - 1; break;
+        }
+        return;
+    }
+    if (leak_view && (ch == '\n' || ch == '\r' || ch == KEY_ENTER)) {
+        if (leak_selected < leak_tracker.suspect_count) {
+            leak_view = 0;
+            jump_to_tid(leak_tracker.entries[leak_tracker.suspects[leak_selected]].pid, available_lines);
+        }
+        return;
+    }
+
+    /* The aggregate view moves its selection; draw_aggregates() clamps it
+     * and scrolls it into view */
+    if (aggregate_view && (ch == KEY_UP || ch == KEY_DOWN || ch == KEY_PPAGE || ch == KEY_NPAGE ||
+                           ch == KEY_HOME || ch == KEY_END)) {
+        switch (ch) {
+            case KEY_UP:    aggregate_selected--; break;
+            case KEY_DOWN:  aggregate_selected++; break;
+            case KEY_PPAGE: aggregate_selected -= page; break;
+            case KEY_NPAGE: aggregate_selected += page; break;
+            case KEY_HOME:  aggregate_selected = 0; break;
+            case KEY_END:   aggregate_selected = aggregates.count - 1; break;
+        }
+        if (aggregate_selected >= aggregates.count) aggregate_selected = aggregates.count - 1;
+        if (aggregate_selected < 0) aggregate_selected = 0;
+        return;
+    }
+    if (aggregate_view && (ch == '\n' || ch == '\r' || ch == KEY_ENTER)) {
+        drill_down();
+        return;
+    }
+    if (drill_view && ch == 27) {
+        drill_view = 0;
+        refresh_data();
+        return;
+    }
 
     switch(ch) {
         case KEY_UP:
@@ -245,7 +1513,7 @@ void handle_input(int ch) {
             break;
 
         case KEY_DOWN:
-            if (selected_index < task_count - 1) {
+            if (selected_index < view_count - 1) {
                 selected_index++;
                 /* Scroll down if selection moves below visible area */
                 if (selected_index >= scroll_offset + available_lines) {
@@ -254,6 +1522,133 @@ void handle_input(int ch) {
             }
             break;
 
+        /* Paging moves the selection and the window together, like less */
+        case KEY_PPAGE:
+            selected_index = selected_index > page ? selected_index - page : 0;
+            scroll_offset -= page;  /* draw_content() clamps this */
+            break;
+
+        case KEY_NPAGE:
+            selected_index = selected_index + page < view_count ? selected_index + page : view_count - 1;
+            if (selected_index < 0) selected_index = 0;
+            scroll_offset += page;
+            break;
+
+        case KEY_HOME:
+            selected_index = 0;
+            scroll_offset = 0;
+            break;
+
+        case KEY_END:
+            selected_index = view_count > 0 ? view_count - 1 : 0;
+            scroll_offset = view_count;
+            break;
+
+        case 'g':
+        case 'G':
+            jump_text[0] = '\0';
+            prompt = PROMPT_JUMP;
+            break;
+
+        case '/':
+            search_text[0] = '\0';
+            prompt = PROMPT_SEARCH;
+            break;
+
+        case 'n':
+            search_from(selected_index + 1, 1, available_lines);
+            break;
+
+        case 'N':
+            search_from(selected_index - 1, -1, available_lines);
+            break;
+
+        case '<':
+            sort_key = next_sort_column(-1);
+            rebuild_view();
+            break;
+
+        case '>':
+            sort_key = next_sort_column(1);
+            rebuild_view();
+            break;
+
+        case 'm':
+        case 'M':
+            toggle_column_group(GROUP_MEMORY);
+            refresh_data();
+            break;
+
+        case 'i':
+            toggle_column_group(GROUP_IO);
+            refresh_data();
+            break;
+
+        case 's':
+        case 'S':
+            toggle_column_group(GROUP_STATE);
+            refresh_data();
+            break;
+
+        case 'o':
+            toggle_column_group(GROUP_FDS);
+            refresh_data();
+            break;
+
+        case 'O':
+            toggle_fd_list();
+            break;
+
+        case 'I':
+            sort_descending = !sort_descending;
+            rebuild_view();
+            break;
+
+        case 'k':
+        case 'K':
+            hide_kernel_threads = !hide_kernel_threads;
+            rebuild_view();
+            break;
+
+        case 'a':
+        case 'A':
+            toggle_aggregates(AGGREGATE_BY_COMMAND);
+            break;
+
+        case 'w':
+        case 'W':
+            toggle_aggregates(AGGREGATE_BY_WAIT);
+            break;
+
+        case 'u':
+        case 'U':
+            toggle_aggregates(AGGREGATE_BY_USER);
+            break;
+
+        case 'r':
+        case 'R':
+            refresh_data();
+            break;
+
+        case 'l':
+        case 'L':
+            toggle_leaks();
+            break;
+
+        case 'p':
+            toggle_profiler();
+            break;
+
+        case 'v':
+        case 'V':
+            toggle_mappings();
+            break;
+
+        case 'f':
+        case 'F':
+            prompt = PROMPT_FILTER;
+            break;
+
         case 'q':
         case 'Q':
             running = 0;
@@ -262,6 +1657,7 @@ void handle_input(int ch) {
         case 'd':
         case 'D':
             debug_mode = !debug_mode;
+            update_layout();
             break;
 
         case 'h':
@@ -275,38 +1671,142 @@ void handle_input(int ch) {
 
 /*
  * Check for keyboard input with timeout
- * Uses select() to wait up to 1 second for input, allowing periodic UI refresh
+ * Uses select() to wait for input until the next periodic refresh is due
  * Returns: 1 if input available, 0 if timeout, -1 on error
  */
 int check_for_keyboard_input(void) {
     fd_set readfds;
     struct timeval timeout;
 
-    timeout.tv_sec = 1;
-    timeout.tv_usec = 0;
+    uint64_t now = monotonic_ns();
+    uint64_t elapsed = now - last_refresh_ns;
+    uint64_t wait_ns = elapsed < refresh_interval_ns ? refresh_interval_ns - elapsed : 0;
+
+    /* A deferred resize is due at the end of the current frame */
+    if (resize_pending) {
+        uint64_t since_layout = now - last_layout_ns;
+        uint64_t resize_ns = since_layout < RESIZE_FRAME_NS ? RESIZE_FRAME_NS - since_layout : 0;
+        if (resize_ns < wait_ns) wait_ns = resize_ns;
+    }
+
+    timeout.tv_sec = wait_ns / 1000000000ULL;
+    timeout.tv_usec = (wait_ns % 1000000000ULL) / 1000;
     FD_ZERO(&readfds);
     FD_SET(STDIN_FILENO, &readfds);
 
     return select(STDIN_FILENO + 1, &readfds, NULL, NULL, &timeout);
 }
 
-int main(void) {
+/* ========== Command Line ========== */
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-b reads] [-P plugin.so] [-r backend] [-s fraction] [-S tasks] [-t column=tier]...\n", prog);
+    fprintf(stderr, "  -b reads        File reads per tick for tasks off screen (default %d, 0 = no limit)\n",
+            DEFAULT_READ_BUDGET);
+    fprintf(stderr, "  -P plugin.so    Load a column plugin (see plugin_api.h); may be repeated\n");
+    fprintf(stderr, "  -r backend      Screen output through ncurses (default) or ansi, which writes\n"
+                    "                  only the changed cells, one write() per frame\n");
+    fprintf(stderr, "  -s fraction     Read a random sample of tasks off screen, e.g. 0.1, and\n"
+                    "                  estimate the aggregate view from it (default 1 = read all)\n");
+    fprintf(stderr, "  -S tasks        Survival mode: preallocate for this many tasks, lock memory,\n"
+                    "                  run at raised priority and never allocate afterwards\n");
+    fprintf(stderr, "  -t column=tier  How often to read a column: fast (%d tick), medium (%d), slow (%d)\n",
+            tier_periods[TIER_FAST], tier_periods[TIER_MEDIUM], tier_periods[TIER_SLOW]);
+    fprintf(stderr, "  Columns:");
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        if (!columns[c].name) continue;
+        fprintf(stderr, " %s (%s)", columns[c].name, tier_name(columns[c].tier));
+    }
+    fprintf(stderr, "\n");
+}
+
+/* Returns: 0 to start the UI, -1 on a bad option */
+static int parse_args(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "b:P:r:s:S:t:h")) != -1) {
+        if (opt == 'b') {
+            char *end;
+            read_budget = (int)strtol(optarg, &end, 10);
+            if (*end != '\0' || read_budget < 0) return -1;
+            continue;
+        }
+        if (opt == 'P') {
+            char error[512];
+            if (plugin_load(optarg, error, sizeof(error)) < 0) {
+                fprintf(stderr, "%s: could not load plugin: %s\n", argv[0], error);
+                return -1;
+            }
+            continue;
+        }
+        if (opt == 'r') {
+            if (parse_backend(optarg, &render_backend) < 0) return -1;
+            continue;
+        }
+        if (opt == 'S') {
+            char *end;
+            survival_tasks = (int)strtol(optarg, &end, 10);
+            if (*end != '\0' || survival_tasks <= 0) return -1;
+            continue;
+        }
+        if (opt == 's') {
+            char *end;
+            sample_fraction = strtod(optarg, &end);
+            if (*end != '\0' || !(sample_fraction > 0.0 && sample_fraction <= 1.0)) return -1;
+            continue;
+        }
+        if (opt != 't') return -1;
+
+        char *tier = strchr(optarg, '=');
+        if (!tier) return -1;
+        *tier++ = '\0';
+        if (set_column_tier(optarg, tier) < 0) {
+            fprintf(stderr, "%s: unknown column or tier '%s=%s'\n", argv[0], optarg, tier);
+            return -1;
+        }
+    }
+    return optind == argc ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    if (parse_args(argc, argv) < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
     signal(SIGWINCH, handle_sigwinch);
-    init_ui();
+    if (init_ui() < 0) {
+        fprintf(stderr, "Could not set up the terminal for the %s backend\n", backend_name(render_backend));
+        return 1;
+    }
 
     /* Collect task data */
-    task_count = collect_task_data(tasks, MAX_TASKS);
+    task_data_init();
+    sort_engine_init(&sort_engine);
+    intmap_init(&priority_tids);
+    intmap_init(&wait_tids);
+    aggregates_init(&aggregates);
+    leak_tracker_init(&leak_tracker);
+    intmap_init(&highlight_tids);
+    diff_engine_init(&diff_engine);
+    diff_add_threshold(&diff_engine, COL_CPU, CPU_ALERT_PERCENT);
+    diff_subscribe(&diff_engine, EVENT_BIT(EVENT_BORN) | EVENT_BIT(EVENT_DIED), note_birth_or_death, NULL);
+    if (survival_tasks && enter_survival_mode() < 0) {
+        cleanup_ui();
+        fprintf(stderr, "Could not reserve memory for %d tasks\n", survival_tasks);
+        return 1;
+    }
+    refresh_data();
 
     /* Main event loop: refresh UI every second and handle keyboard input */
     while (running) {
-        /* Handle terminal resize */
-        if (resize_pending) {
-            resize_pending = 0;
+        /* Handle terminal resize; a burst of SIGWINCH while the window is
+         * dragged is applied with one re-layout per frame */
+        if (resize_pending && monotonic_ns() - last_layout_ns >= RESIZE_FRAME_NS) {
             handle_resize();
         }
 
-        /* Redraw the UI */
-        draw_ui();
+        /* Redraw the UI, unless a re-layout for the new size is still due */
+        if (!resize_pending) draw_ui();
 
         /* Wait for keyboard input (with 1 second timeout for periodic refresh) */
         int input_status = check_for_keyboard_input();
@@ -324,19 +1824,48 @@ int main(void) {
             running = 0;
 
         } else if (input_status > 0) {
-            /* Keyboard input is available - read and handle it */
+            /* Keyboard input is available - handle every queued key before
+             * the next redraw, so a held key costs one frame, not one per repeat */
             select_input_count++;
             last_errno = 0;
-            int ch = getch();
-            handle_input(ch);
+            int ch;
+            int keys = 0;
+            while (running && (ch = render_getch()) != ERR) {
+                handle_input(ch);
+                keys++;
+            }
+            if (keys > 1) coalesced_key_count += keys - 1;
 
         } else {
             /* Timeout - no input, just continue to refresh UI */
             select_timeout_count++;
             last_errno = 0;
         }
+
+        /* Periodic data refresh, also when input kept select() from timing out */
+        if (monotonic_ns() - last_refresh_ns >= refresh_interval_ns) {
+            refresh_data();
+        }
     }
 
     cleanup_ui();
+    sort_engine_free(&sort_engine);
+    intmap_free(&priority_tids);
+    intmap_free(&wait_tids);
+    aggregates_free(&aggregates);
+    leak_tracker_free(&leak_tracker);
+    diff_engine_free(&diff_engine);
+    intmap_free(&highlight_tids);
+    plugins_unload();
+    profiler_stop(&profiler);
+    symbol_cache_free();
+    mapping_tracker_stop(&mapping_tracker);
+    fd_list_close(&fd_list);
+    free(view_rows);
+    free(prev_view_rows);
+    free(row_placed);
+    free(view_pos);
+    snapshot_pool_destroy();
+    task_data_cleanup();
     return 0;
 }
@@ -0,0 +1,127 @@
+#include "plugin.h"
+#include "columns.h"
+#include "timing.h"
+#include <stdio.h>
+#include <string.h>
+#include <dlfcn.h>
+
+typedef struct {
+    PluginColumn decl;
+    ColumnId column;
+    PluginColumnStats stats;
+} LoadedColumn;
+
+static LoadedColumn loaded[MAX_PLUGIN_COLUMNS];
+static int loaded_count = 0;
+
+static void *handles[MAX_PLUGINS];
+static int handle_count = 0;
+
+/* ========== Registration ========== */
+
+static int register_column(void *host, const PluginColumn *column) {
+    (void)host;
+    if (loaded_count == MAX_PLUGIN_COLUMNS || !column->name || !column->title || !column->fill) {
+        return -1;
+    }
+
+    int id = add_plugin_column(column->name, column->title, column->width, column->type);
+    if (id < 0) return -1;
+
+    LoadedColumn *entry = &loaded[loaded_count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->decl = *column;
+    entry->column = id;
+    entry->stats.name = column->name;
+    return 0;
+}
+
+int plugin_load(const char *path, char *error, size_t size) {
+    if (handle_count == MAX_PLUGINS) {
+        snprintf(error, size, "at most %d plugins", MAX_PLUGINS);
+        return -1;
+    }
+
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        snprintf(error, size, "%s", dlerror());
+        return -1;
+    }
+
+    /* Cast through a union: ISO C has no conversion from void* to a function pointer */
+    union { void *symbol; PluginInit init; } entry;
+    entry.symbol = dlsym(handle, PLUGIN_INIT_SYMBOL);
+    if (!entry.symbol) {
+        snprintf(error, size, "no %s in %s", PLUGIN_INIT_SYMBOL, path);
+        dlclose(handle);
+        return -1;
+    }
+
+    PluginHost host = {PLUGIN_API_VERSION, register_column, NULL};
+    int columns_before = loaded_count;
+    if (entry.init(&host) < 0) {
+        snprintf(error, size, "%s refused to load", path);
+        /* Columns it declared before refusing stay; their code must stay mapped */
+        if (loaded_count == columns_before) dlclose(handle);
+        else handles[handle_count++] = handle;
+        return -1;
+    }
+
+    handles[handle_count++] = handle;
+    return 0;
+}
+
+void plugins_unload(void) {
+    for (int i = 0; i < handle_count; i++) dlclose(handles[i]);
+    handle_count = 0;
+    loaded_count = 0;
+}
+
+/* ========== Filling ========== */
+
+static void* snapshot_alloc(void *arena, size_t size) {
+    return arena_alloc(arena, size);
+}
+
+int plugins_fill(Snapshot *snapshot) {
+    int count = snapshot->count;
+    if (loaded_count == 0 || count == 0) return 0;
+
+    /* Column-at-a-time: the row arrays are built once for every column */
+    int *pids = arena_alloc(&snapshot->arena, count * sizeof(int));
+    int *tids = arena_alloc(&snapshot->arena, count * sizeof(int));
+    PluginValue *values = arena_alloc(&snapshot->arena, count * sizeof(PluginValue));
+    if (!pids || !tids || !values) return -1;
+
+    for (int i = 0; i < count; i++) {
+        pids[i] = snapshot->tasks[i].pid;
+        tids[i] = snapshot->tasks[i].tid;
+    }
+
+    for (int c = 0; c < loaded_count; c++) {
+        LoadedColumn *entry = &loaded[c];
+        int slot = entry->column - COL_PLUGIN_FIRST;
+
+        memset(values, 0, count * sizeof(PluginValue));
+        PluginBatch batch = {count, pids, tids, values, snapshot_alloc, &snapshot->arena};
+
+        uint64_t start = monotonic_ns();
+        entry->decl.fill(&batch, entry->decl.context);
+        entry->stats.last_ns = monotonic_ns() - start;
+        entry->stats.total_ns += entry->stats.last_ns;
+        entry->stats.calls++;
+
+        for (int i = 0; i < count; i++) {
+            snapshot->tasks[i].plugin_values[slot] = values[i];
+        }
+    }
+    return 0;
+}
+
+int plugin_column_count(void) {
+    return loaded_count;
+}
+
+const PluginColumnStats* plugin_column_stats(int index) {
+    return &loaded[index].stats;
+}
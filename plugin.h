@@ -0,0 +1,42 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "plugin_api.h"
+#include "snapshot.h"
+
+/* ========== Plugin Host ========== */
+
+/*
+ * Loads column plugins (see plugin_api.h) and fills their columns. Each
+ * column costs one call per snapshot, over pid and tid arrays built once
+ * and shared by every column; the values are then copied into the tasks so
+ * sorting and drawing treat them like any other column.
+ */
+
+#define MAX_PLUGINS 8
+
+typedef struct {
+    const char *name;
+    uint64_t last_ns;        /* Time in the last fill call */
+    uint64_t total_ns;
+    unsigned long calls;
+} PluginColumnStats;
+
+/* dlopen() a plugin and run its init function
+ * Returns: -1 with a reason in error if it could not be loaded
+ */
+int plugin_load(const char *path, char *error, size_t size);
+
+/* Fill every plugin column for a freshly collected snapshot
+ * Returns: -1 if the snapshot ran out of memory for the batch
+ */
+int plugins_fill(Snapshot *snapshot);
+
+int plugin_column_count(void);
+const PluginColumnStats* plugin_column_stats(int index);
+
+void plugins_unload(void);
+
+#endif /* PLUGIN_H */
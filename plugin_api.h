@@ -0,0 +1,74 @@
+#ifndef PLUGIN_API_H
+#define PLUGIN_API_H
+
+#include <stddef.h>
+
+/* ========== Column Plugins ========== */
+
+/*
+ * A plugin is a shared object loaded with -P. Its init function declares
+ * columns; each column is then filled once per snapshot by one call over
+ * every row, never once per row:
+ *
+ *     static void fill(PluginBatch *batch, void *context) {
+ *         for (int i = 0; i < batch->count; i++) {
+ *             batch->values[i].text = lookup(batch->pids[i]);
+ *         }
+ *     }
+ *
+ *     int pel_plugin_init(const PluginHost *host) {
+ *         PluginColumn column = {"service", "Service", 16, PLUGIN_TEXT, fill, NULL};
+ *         return host->register_column(host->host, &column);
+ *     }
+ *
+ * This header is all a plugin needs; it does not link against the host.
+ */
+
+#define PLUGIN_API_VERSION 1
+#define PLUGIN_INIT_SYMBOL "pel_plugin_init"
+
+typedef enum {
+    PLUGIN_TEXT,     /* Left-aligned, sorted by its first eight bytes */
+    PLUGIN_NUMBER    /* Right-aligned, sorted numerically */
+} PluginValueType;
+
+typedef union {
+    double number;
+    const char *text;   /* NULL shows as "-" */
+} PluginValue;
+
+/* One snapshot's rows, as parallel arrays */
+typedef struct {
+    int count;
+    const int *pids;
+    const int *tids;
+    PluginValue *values;   /* Zeroed; fill values[i] for row i */
+
+    /* Memory that lives exactly as long as the snapshot, e.g. for text
+     * values. Returns: NULL if the snapshot is out of memory */
+    void* (*alloc)(void *arena, size_t size);
+    void *arena;
+} PluginBatch;
+
+typedef struct {
+    const char *name;      /* Short name for -t, e.g. "service" */
+    const char *title;     /* Table header */
+    int width;
+    PluginValueType type;
+    void (*fill)(PluginBatch *batch, void *context);
+    void *context;         /* Passed back to fill */
+} PluginColumn;
+
+typedef struct {
+    int api_version;       /* PLUGIN_API_VERSION of the host */
+
+    /* Copies the declaration; name and title must stay valid.
+     * Returns: -1 if every column slot is taken */
+    int (*register_column)(void *host, const PluginColumn *column);
+    void *host;
+} PluginHost;
+
+/* Exported by every plugin under PLUGIN_INIT_SYMBOL. Returns: -1 to refuse loading */
+typedef int (*PluginInit)(const PluginHost *host);
+
+#endif /* PLUGIN_API_H */
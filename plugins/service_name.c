@@ -0,0 +1,106 @@
+/*
+ * Example column plugin: the service a process belongs to, looked up in a
+ * registry file of "<pid> <service>" lines, e.g. written by a supervisor:
+ *
+ *     make plugins
+ *     PEL_SERVICE_REGISTRY=/run/services ./processexplorer -P plugins/service_name.so
+ *
+ * The file is re-read only when its modification time changes, and each
+ * batch is answered with one binary search per row.
+ */
+
+#include "plugin_api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define NAME_LEN 32
+
+typedef struct {
+    int pid;
+    char name[NAME_LEN];
+    const char *copy;     /* This batch's copy in the snapshot, once used */
+} Service;
+
+static Service *services = NULL;
+static int service_count = 0;
+static struct timespec loaded_mtime;
+
+static int compare_pid(const void *a, const void *b) {
+    int x = ((const Service *)a)->pid;
+    int y = ((const Service *)b)->pid;
+    return (x > y) - (x < y);
+}
+
+/* Re-read the registry if it changed. A missing file means no services */
+static void reload(const char *path) {
+    struct stat st;
+    if (stat(path, &st) < 0) {
+        service_count = 0;
+        return;
+    }
+    if (st.st_mtim.tv_sec == loaded_mtime.tv_sec && st.st_mtim.tv_nsec == loaded_mtime.tv_nsec) return;
+
+    FILE *file = fopen(path, "r");
+    if (!file) return;
+    loaded_mtime = st.st_mtim;
+    service_count = 0;
+
+    int capacity = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        int pid;
+        char name[NAME_LEN];
+        if (sscanf(line, "%d %31s", &pid, name) != 2) continue;
+
+        if (service_count == capacity) {
+            int new_capacity = capacity ? capacity * 2 : 64;
+            Service *grown = realloc(services, new_capacity * sizeof(Service));
+            if (!grown) break;
+            services = grown;
+            capacity = new_capacity;
+        }
+        services[service_count].pid = pid;
+        memcpy(services[service_count].name, name, NAME_LEN);
+        service_count++;
+    }
+    fclose(file);
+
+    qsort(services, service_count, sizeof(Service), compare_pid);
+}
+
+static void fill(PluginBatch *batch, void *context) {
+    const char *path = getenv("PEL_SERVICE_REGISTRY");
+    (void)context;
+    if (!path) return;
+
+    reload(path);
+    if (service_count == 0) return;
+
+    for (int i = 0; i < service_count; i++) services[i].copy = NULL;
+
+    for (int i = 0; i < batch->count; i++) {
+        Service key;
+        key.pid = batch->pids[i];
+        Service *service = bsearch(&key, services, service_count, sizeof(Service), compare_pid);
+        if (!service) continue;
+
+        /* Values must outlive this call; one copy per service per snapshot */
+        if (!service->copy) {
+            size_t size = strlen(service->name) + 1;
+            char *copy = batch->alloc(batch->arena, size);
+            if (!copy) return;
+            memcpy(copy, service->name, size);
+            service->copy = copy;
+        }
+        batch->values[i].text = service->copy;
+    }
+}
+
+int pel_plugin_init(const PluginHost *host) {
+    if (host->api_version != PLUGIN_API_VERSION) return -1;
+
+    PluginColumn column = {"service", "Service", 12, PLUGIN_TEXT, fill, NULL};
+    return host->register_column(host->host, &column);
+}
@@ -0,0 +1,383 @@
+#include "profiler.h"
+#include "survival.h"
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/* Longest folded stack line; deeper stacks lose their outermost frames */
+#define FOLDED_MAX 8192
+
+#ifdef __linux__
+
+/* Scratch for a record that wraps around the end of its ring */
+static uint64_t wrapped_record[65536 / sizeof(uint64_t)];
+
+static size_t ring_data_size(void) {
+    return (size_t)PROFILER_RING_PAGES * sysconf(_SC_PAGESIZE);
+}
+
+/* ========== Threads ========== */
+
+static int open_thread(Profiler *profiler, int tid) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_TASK_CLOCK;   /* Ticks only while the thread is on a CPU */
+    attr.freq = 1;
+    attr.sample_freq = PROFILER_FREQUENCY;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+    attr.sample_max_stack = PROFILER_MAX_STACK;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_callchain_kernel = 1;
+
+    int fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) return -1;
+
+    /* Writable, so the kernel respects data_tail and never overwrites unread samples */
+    void *ring = mmap(NULL, sysconf(_SC_PAGESIZE) + ring_data_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring == MAP_FAILED) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    ProfiledThread *thread = &profiler->threads[profiler->thread_count++];
+    thread->tid = tid;
+    thread->fd = fd;
+    thread->ring = ring;
+    thread->seen = 1;
+    return 0;
+}
+
+static void close_thread(ProfiledThread *thread) {
+    munmap(thread->ring, sysconf(_SC_PAGESIZE) + ring_data_size());
+    close(thread->fd);
+}
+
+/* Open events for threads started since the last scan and mark the ones still alive.
+ * Returns: -1 if no thread could be opened, with errno from the last failure
+ */
+static int scan_threads(Profiler *profiler) {
+    for (int i = 0; i < profiler->thread_count; i++) profiler->threads[i].seen = 0;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", profiler->pid);
+    DIR *dir = opendir(path);
+    if (!dir) return -1;
+
+    int failures = 0;
+    int error = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        int tid = atoi(entry->d_name);
+        if (tid <= 0) continue;
+
+        int known = 0;
+        for (int i = 0; i < profiler->thread_count && !known; i++) {
+            if (profiler->threads[i].tid == tid) {
+                profiler->threads[i].seen = 1;
+                known = 1;
+            }
+        }
+        if (known) continue;
+
+        if (profiler->thread_count == PROFILER_MAX_THREADS) {
+            failures++;
+        } else if (open_thread(profiler, tid) < 0) {
+            failures++;
+            error = errno;
+        }
+    }
+    closedir(dir);
+
+    profiler->thread_errors = failures;
+    if (profiler->thread_count == 0) {
+        errno = error ? error : ESRCH;
+        return -1;
+    }
+    return 0;
+}
+
+/* ========== Aggregation ========== */
+
+static int grow_rows(Profiler *profiler, int new_capacity) {
+    if (heap_frozen) return -1;
+    ProfileRow *rows = realloc(profiler->rows, new_capacity * sizeof(ProfileRow));
+    if (!rows) return -1;
+    profiler->rows = rows;
+
+    int *order = realloc(profiler->order, new_capacity * sizeof(int));
+    if (!order) return -1;
+    profiler->order = order;
+
+    profiler->row_capacity = new_capacity;
+    return 0;
+}
+
+static int grow_stacks(Profiler *profiler, int new_capacity) {
+    if (heap_frozen) return -1;
+    unsigned long *counts = realloc(profiler->stack_counts, new_capacity * sizeof(unsigned long));
+    if (!counts) return -1;
+    memset(counts + profiler->stack_capacity, 0, (new_capacity - profiler->stack_capacity) * sizeof(unsigned long));
+    profiler->stack_counts = counts;
+    profiler->stack_capacity = new_capacity;
+    return 0;
+}
+
+/* Returns: the function id for an address, -1 on allocation failure */
+static int function_at(Profiler *profiler, uint64_t address) {
+    AddressCacheEntry *cached = &profiler->address_cache[(address ^ address >> 12) & (PROFILER_ADDRESS_CACHE - 1)];
+    if (cached->address == address) return cached->function;
+
+    Symbol symbol;
+    symbolize(&profiler->symbols, address, &symbol);
+
+    char pseudo[80];
+    const char *name = symbol.function;
+    if (!name) {
+        snprintf(pseudo, sizeof(pseudo), "[%s]", symbol.object ? symbol.object : "unknown");
+        name = pseudo;
+    }
+
+    /* Room for a new function's row first, so every interned one has a row */
+    int known = profiler->functions.count;
+    if (known >= profiler->row_capacity &&
+        grow_rows(profiler, profiler->row_capacity ? profiler->row_capacity * 2 : 256) < 0) {
+        return -1;
+    }
+    int function = intern_string(&profiler->functions, name);
+    if (function < 0) return -1;
+    if (function >= known) {
+        ProfileRow *row = &profiler->rows[function];
+        memset(row, 0, sizeof(*row));
+        row->object = symbol.object ? intern_string(&profiler->objects, symbol.object) : -1;
+    }
+
+    cached->address = address;
+    cached->function = function;
+    return function;
+}
+
+static void count_folded(Profiler *profiler, const int *frames, int depth) {
+    char folded[FOLDED_MAX];
+
+    /* The line runs outermost frame first, but the leaf must survive: find
+     * the outermost frame that still fits, each name taking a separator */
+    size_t needed = 0;
+    int top = 0;
+    while (top < depth) {
+        size_t length = strlen(intern_lookup(&profiler->functions, frames[top])) + 1;
+        if (needed + length > sizeof(folded)) break;
+        needed += length;
+        top++;
+    }
+
+    size_t used = 0;
+    for (int i = top - 1; i >= 0; i--) {
+        const char *name = intern_lookup(&profiler->functions, frames[i]);
+        size_t length = strlen(name);
+        if (used) folded[used++] = ';';
+        memcpy(folded + used, name, length);
+        used += length;
+    }
+    folded[used] = '\0';
+
+    /* Past the cap only stacks seen before still count */
+    int stack = profiler->stacks.count < PROFILER_MAX_STACKS ?
+                intern_string(&profiler->stacks, folded) : intern_find(&profiler->stacks, folded);
+    if (stack < 0 || (stack >= profiler->stack_capacity &&
+                      grow_stacks(profiler, profiler->stack_capacity ? profiler->stack_capacity * 2 : 1024) < 0)) {
+        profiler->dropped_stacks++;
+        return;
+    }
+    profiler->stack_counts[stack]++;
+}
+
+/* Callchain entries are leaf first; context markers sit at the top of the address space */
+static void record_sample(Profiler *profiler, const uint64_t *ips, uint64_t nr) {
+    int frames[PROFILER_MAX_STACK];
+    int depth = 0;
+    for (uint64_t i = 0; i < nr && depth < PROFILER_MAX_STACK; i++) {
+        if (ips[i] >= PERF_CONTEXT_MAX) continue;
+
+        /* Callers' entries are return addresses; step back into the call instruction */
+        int function = function_at(profiler, depth == 0 ? ips[i] : ips[i] - 1);
+        if (function < 0) return;
+        frames[depth++] = function;
+    }
+    if (depth == 0) return;
+
+    unsigned long stamp = ++profiler->samples;
+    profiler->rows[frames[0]].self++;
+    for (int i = 0; i < depth; i++) {
+        ProfileRow *row = &profiler->rows[frames[i]];
+        if (row->stamp == stamp) continue;   /* Recursion counts once */
+        row->stamp = stamp;
+        row->total++;
+    }
+    count_folded(profiler, frames, depth);
+}
+
+static void handle_record(Profiler *profiler, const struct perf_event_header *header) {
+    const uint64_t *body = (const uint64_t *)(header + 1);
+    size_t words = (header->size - sizeof(*header)) / sizeof(uint64_t);
+
+    if (header->type == PERF_RECORD_SAMPLE && words >= 2) {
+        /* { u32 pid, tid; u64 nr; u64 ips[nr]; } */
+        uint64_t nr = body[1];
+        if (nr <= words - 2) record_sample(profiler, body + 2, nr);
+    } else if (header->type == PERF_RECORD_LOST && words >= 2) {
+        profiler->lost += body[1];
+    }
+}
+
+/* Consume everything between data_tail and data_head; never waits for more */
+static int drain_ring(Profiler *profiler, ProfiledThread *thread) {
+    struct perf_event_mmap_page *meta = thread->ring;
+    unsigned char *data = (unsigned char *)thread->ring + sysconf(_SC_PAGESIZE);
+    uint64_t size = ring_data_size();
+    unsigned long before = profiler->samples;
+
+    uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = meta->data_tail;
+    while (tail < head) {
+        /* Records are 8-byte aligned, so a header never straddles the end */
+        uint64_t at = tail & (size - 1);
+        const struct perf_event_header *header = (const void *)(data + at);
+        uint16_t length = header->size;
+        if (length < sizeof(*header) || length > head - tail) break;
+
+        if (at + length > size) {
+            memcpy(wrapped_record, data + at, size - at);
+            memcpy((unsigned char *)wrapped_record + (size - at), data, length - (size - at));
+            header = (const void *)wrapped_record;
+        }
+        handle_record(profiler, header);
+        tail += length;
+    }
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+    return (int)(profiler->samples - before);
+}
+
+/* ========== Public Interface ========== */
+
+int profiler_start(Profiler *profiler, int pid) {
+    memset(profiler, 0, sizeof(*profiler));
+    if (heap_frozen) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    profiler->pid = pid;
+    memset(profiler->address_cache, 0xff, sizeof(profiler->address_cache));
+    intern_init(&profiler->functions);
+    intern_init(&profiler->objects);
+    intern_init(&profiler->stacks);
+
+    if (process_symbols_open(&profiler->symbols, pid) < 0 || scan_threads(profiler) < 0) {
+        int saved = errno;
+        profiler_stop(profiler);
+        errno = saved;
+        return -1;
+    }
+    profiler->active = 1;
+    profiler->started_ns = monotonic_ns();
+    return 0;
+}
+
+void profiler_stop(Profiler *profiler) {
+    for (int i = 0; i < profiler->thread_count; i++) close_thread(&profiler->threads[i]);
+    process_symbols_close(&profiler->symbols);
+    intern_free(&profiler->functions);
+    intern_free(&profiler->objects);
+    intern_free(&profiler->stacks);
+    free(profiler->rows);
+    free(profiler->order);
+    free(profiler->stack_counts);
+    memset(profiler, 0, sizeof(*profiler));
+}
+
+static const Profiler *rank_profiler;
+
+static int compare_self_desc(const void *a, const void *b) {
+    const ProfileRow *ra = &rank_profiler->rows[*(const int *)a];
+    const ProfileRow *rb = &rank_profiler->rows[*(const int *)b];
+    if (ra->self != rb->self) return ra->self < rb->self ? 1 : -1;
+    if (ra->total != rb->total) return ra->total < rb->total ? 1 : -1;
+    return *(const int *)a - *(const int *)b;
+}
+
+int profiler_drain(Profiler *profiler) {
+    if (!profiler->active) return 0;
+    uint64_t start = monotonic_ns();
+
+    /* Rings of threads that exited are drained one last time before closing */
+    scan_threads(profiler);
+    int read = 0;
+    for (int i = 0; i < profiler->thread_count; i++) {
+        read += drain_ring(profiler, &profiler->threads[i]);
+    }
+    for (int i = 0; i < profiler->thread_count; ) {
+        if (profiler->threads[i].seen) {
+            i++;
+            continue;
+        }
+        close_thread(&profiler->threads[i]);
+        profiler->threads[i] = profiler->threads[--profiler->thread_count];
+    }
+
+    profiler->order_count = profiler->functions.count;
+    for (int i = 0; i < profiler->order_count; i++) profiler->order[i] = i;
+    rank_profiler = profiler;
+    qsort(profiler->order, profiler->order_count, sizeof(int), compare_self_desc);
+
+    profiler->drain_ns = monotonic_ns() - start;
+    return read;
+}
+
+#else /* !__linux__ */
+
+int profiler_start(Profiler *profiler, int pid) {
+    (void)pid;
+    memset(profiler, 0, sizeof(*profiler));
+    errno = ENOSYS;
+    return -1;
+}
+
+void profiler_stop(Profiler *profiler) {
+    memset(profiler, 0, sizeof(*profiler));
+}
+
+int profiler_drain(Profiler *profiler) {
+    (void)profiler;
+    return 0;
+}
+
+#endif /* __linux__ */
+
+int profiler_export_folded(const Profiler *profiler, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) return -1;
+
+    int written = 0;
+    for (int i = 0; i < profiler->stacks.count && i < profiler->stack_capacity; i++) {
+        if (!profiler->stack_counts[i]) continue;
+        fprintf(file, "%s %lu\n", intern_lookup(&profiler->stacks, i), profiler->stack_counts[i]);
+        written++;
+    }
+    if (fclose(file) != 0) return -1;
+    return written;
+}
@@ -0,0 +1,86 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "intern.h"
+#include "symbols.h"
+
+/* ========== Sampling Profiler ========== */
+
+/*
+ * Samples the user-space call stacks of one process with perf_event_open:
+ * one task-clock event per thread, each writing into its own mmap ring.
+ * profiler_drain() copies out whatever the kernel has written so far and
+ * never waits for more, so it can run on the UI thread once per refresh.
+ * Samples are symbolized as they are drained and accumulated into per-function
+ * counts for the top-functions table and into folded stacks for export
+ * (one "outer;...;leaf count" line per distinct stack, as flame graph tools
+ * read them).
+ */
+
+#define PROFILER_FREQUENCY 99      /* Samples per second of CPU time, per thread; off the timer tick */
+#define PROFILER_MAX_THREADS 64
+#define PROFILER_RING_PAGES 32     /* Data pages per thread ring, a power of two */
+#define PROFILER_MAX_STACK 64      /* Frames kept per sample */
+#define PROFILER_MAX_STACKS 20000  /* Distinct folded stacks kept for export */
+#define PROFILER_ADDRESS_CACHE 4096
+
+typedef struct {
+    int tid;
+    int fd;
+    void *ring;             /* Metadata page followed by the data pages */
+    int seen;               /* Still listed in /proc/[pid]/task at the last scan */
+} ProfiledThread;
+
+typedef struct {
+    int object;             /* Id in Profiler.objects, -1 if unmapped */
+    unsigned long self;     /* Samples with the function on top of the stack */
+    unsigned long total;    /* Samples with it anywhere on the stack */
+    unsigned long stamp;    /* Sample that last counted towards total */
+} ProfileRow;
+
+typedef struct {
+    uint64_t address;
+    int function;
+} AddressCacheEntry;
+
+typedef struct {
+    int active;
+    int pid;
+    uint64_t started_ns;
+
+    ProfiledThread threads[PROFILER_MAX_THREADS];
+    int thread_count;
+    int thread_errors;      /* Threads that could not be opened, e.g. over the limit */
+
+    ProcessSymbols symbols;
+    AddressCacheEntry address_cache[PROFILER_ADDRESS_CACHE];
+
+    InternTable functions;  /* "name", or "[object]" for an address without a symbol */
+    InternTable objects;
+    ProfileRow *rows;       /* Indexed by function id */
+    int row_capacity;
+    int *order;             /* Function ids, most self samples first */
+    int order_count;
+
+    InternTable stacks;     /* Folded stacks, outermost frame first */
+    unsigned long *stack_counts;
+    int stack_capacity;
+
+    unsigned long samples;
+    unsigned long lost;     /* Samples the kernel dropped on a full ring */
+    unsigned long dropped_stacks;   /* Samples whose stack did not fit PROFILER_MAX_STACKS */
+    uint64_t drain_ns;      /* Time the last drain took */
+} Profiler;
+
+/* Start sampling every thread of pid. Returns: -1 with errno set */
+int profiler_start(Profiler *profiler, int pid);
+void profiler_stop(Profiler *profiler);
+
+/* Read every ring without blocking and re-rank the functions. Returns: samples read */
+int profiler_drain(Profiler *profiler);
+
+/* Returns: stacks written, -1 with errno set */
+int profiler_export_folded(const Profiler *profiler, const char *path);
+
+#endif /* PROFILER_H */
@@ -0,0 +1,599 @@
+#include "render.h"
+#include "survival.h"
+#include "timing.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+
+#define MAX_PAIRS 16
+#define ESC_DELAY_MS 25       /* Same wait for the rest of a key sequence as under ncurses */
+#define PROBE_TIMEOUT_MS 100  /* How long the terminal gets to answer the mode query */
+#define MAX_CURSOR_GAP 4      /* Unchanged cells rewritten rather than moved over */
+#define BLANK_ATTRS 0
+#define UNKNOWN_ATTRS 0xffff  /* Front-grid cell whose contents are not known */
+#define KEY_INCOMPLETE -2     /* More bytes are needed to decode the key */
+
+static RenderBackend backend = BACKEND_NCURSES;
+static RenderStats stats;
+static int current_attrs = 0;
+static uint64_t frame_start_ns = 0;
+
+/* ========== ncurses Backend ========== */
+
+static chtype curses_attrs(int attrs) {
+    chtype result = COLOR_PAIR(attrs & 0xff);
+    if (attrs & ATTR_BOLD) result |= A_BOLD;
+    if (attrs & ATTR_DIM) result |= A_DIM;
+    if (attrs & ATTR_REVERSE) result |= A_REVERSE;
+    if (attrs & ATTR_UNDERLINE) result |= A_UNDERLINE;
+    return result;
+}
+
+static int curses_init(void) {
+    if (!initscr()) return -1;
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    nodelay(stdscr, TRUE);  /* getch() returns ERR once the queued keys are used up */
+    set_escdelay(ESC_DELAY_MS);  /* Escape closes a prompt without a 1s wait */
+    curs_set(0);
+    idlok(stdscr, TRUE);  /* Moved lines may be scrolled with insert/delete line */
+    if (has_colors()) start_color();
+    return 0;
+}
+
+/* ========== ANSI Backend ========== */
+
+typedef struct {
+    unsigned short attrs;
+    char ch;
+} Cell;
+
+static struct {
+    int rows;
+    int cols;
+    int capacity;             /* Cells allocated in each grid */
+    Cell *back;               /* The frame being drawn */
+    Cell *front;              /* What the terminal shows */
+    int cursor_y;             /* Where render_append() continues */
+    int cursor_x;
+
+    int scroll_top;           /* Scroll hint for the next frame: rows top..bottom-1 */
+    int scroll_bottom;
+    int scroll_lines;         /* moved up by this many, down if negative; 0 = none */
+
+    char *out;                /* Escape sequences for one frame, written at once */
+    size_t out_len;
+    size_t out_cap;
+
+    unsigned char in[256];    /* Key bytes read but not decoded yet */
+    int in_len;
+
+    unsigned char fg[MAX_PAIRS];
+    unsigned char bg[MAX_PAIRS];
+    struct termios saved;
+} ansi;
+
+static void out_flush(void) {
+    size_t done = 0;
+    while (done < ansi.out_len) {
+        ssize_t n = write(STDOUT_FILENO, ansi.out + done, ansi.out_len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        done += n;
+    }
+    stats.last_frame_bytes += done;
+    ansi.out_len = 0;
+}
+
+static int grow_out(size_t needed) {
+    if (heap_frozen) return -1;
+
+    size_t new_cap = ansi.out_cap ? ansi.out_cap : 4096;
+    while (new_cap < needed) new_cap *= 2;
+    char *out = realloc(ansi.out, new_cap);
+    if (!out) return -1;
+    ansi.out = out;
+    ansi.out_cap = new_cap;
+    return 0;
+}
+
+static void out_bytes(const char *data, size_t len) {
+    if (ansi.out_len + len > ansi.out_cap && grow_out(ansi.out_len + len) < 0) {
+        /* Out of room: split the frame over several writes rather than drop it */
+        out_flush();
+        if (len > ansi.out_cap) {
+            ansi.out_len = 0;
+            return;
+        }
+    }
+    memcpy(ansi.out + ansi.out_len, data, len);
+    ansi.out_len += len;
+}
+
+static void out_str(const char *str) {
+    out_bytes(str, strlen(str));
+}
+
+static void out_printf(const char *fmt, ...) {
+    char seq[64];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(seq, sizeof(seq), fmt, ap);
+    va_end(ap);
+    if (len > 0) out_bytes(seq, len < (int)sizeof(seq) ? (size_t)len : sizeof(seq) - 1);
+}
+
+static void fill_cells(Cell *cells, int count, unsigned short attrs) {
+    for (int i = 0; i < count; i++) {
+        cells[i].ch = ' ';
+        cells[i].attrs = attrs;
+    }
+}
+
+/*
+ * Size the grids to the terminal and forget what it shows, so the next frame
+ * is painted in full. Once the heap is frozen the grids cannot grow: a larger
+ * terminal is drawn into the top-left part that fits.
+ */
+static int size_grids(void) {
+    int rows = 24;
+    int cols = 80;
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    }
+
+    if (rows * cols > ansi.capacity) {
+        Cell *back = heap_frozen ? NULL : realloc(ansi.back, rows * cols * sizeof(Cell));
+        if (back) ansi.back = back;
+        Cell *front = back ? realloc(ansi.front, rows * cols * sizeof(Cell)) : NULL;
+        if (front) {
+            ansi.front = front;
+            ansi.capacity = rows * cols;
+        } else {
+            if (ansi.capacity == 0) return -1;
+            while (rows > 1 && rows * cols > ansi.capacity) rows--;
+            if (rows * cols > ansi.capacity) cols = ansi.capacity / rows;
+        }
+    }
+
+    ansi.rows = rows;
+    ansi.cols = cols;
+    ansi.scroll_lines = 0;
+    fill_cells(ansi.back, rows * cols, BLANK_ATTRS);
+    fill_cells(ansi.front, rows * cols, UNKNOWN_ATTRS);
+    out_str("\x1b[0m\x1b[2J");
+    return 0;
+}
+
+/* Wait up to timeout_ms for input. Returns: 1 if there is some */
+static int wait_input(int timeout_ms) {
+    fd_set readfds;
+    struct timeval timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    FD_ZERO(&readfds);
+    FD_SET(STDIN_FILENO, &readfds);
+    return select(STDIN_FILENO + 1, &readfds, NULL, NULL, &timeout) > 0;
+}
+
+/*
+ * Ask whether the terminal knows synchronized output (DEC mode 2026). Device
+ * attributes are queried right after it: every terminal answers those, so
+ * their reply ends the wait without running into the timeout.
+ */
+static int probe_synchronized_output(void) {
+    static const char query[] = "\x1b[?2026$p\x1b[c";
+    if (write(STDOUT_FILENO, query, sizeof(query) - 1) < 0) return 0;
+
+    char reply[256];
+    size_t len = 0;
+    uint64_t deadline = monotonic_ns() + PROBE_TIMEOUT_MS * 1000000ULL;
+    while (len < sizeof(reply) - 1 && !memchr(reply, 'c', len)) {
+        uint64_t now = monotonic_ns();
+        if (now >= deadline || !wait_input((int)((deadline - now) / 1000000ULL) + 1)) break;
+        ssize_t n = read(STDIN_FILENO, reply + len, sizeof(reply) - 1 - len);
+        if (n <= 0) break;
+        len += n;
+    }
+    reply[len] = '\0';
+
+    /* Mode states 1-3 (set, reset, permanently set) mean it is recognised */
+    const char *mode = strstr(reply, "\x1b[?2026;");
+    return mode && mode[8] >= '1' && mode[8] <= '3';
+}
+
+static int ansi_init(void) {
+    if (tcgetattr(STDIN_FILENO, &ansi.saved) < 0) return -1;
+
+    /* Like cbreak() and noecho(); signals still work, reads never block */
+    struct termios raw = ansi.saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) < 0) return -1;
+
+    stats.synchronized = probe_synchronized_output();
+
+    /* Alternate screen, hidden cursor, no auto-wrap so the last column is safe */
+    if (grow_out(4096) < 0) return -1;
+    out_str("\x1b[?1049h\x1b[?25l\x1b[?7l");
+    if (size_grids() < 0) return -1;
+    out_flush();
+
+    /* Room for a full repaint, so frames stay one write() once the heap is frozen */
+    return grow_out(ansi.capacity * 4);
+}
+
+static void ansi_end(void) {
+    out_str("\x1b[0m\x1b[?7h\x1b[?25h\x1b[?1049l");
+    out_flush();
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &ansi.saved);
+
+    free(ansi.back);
+    free(ansi.front);
+    free(ansi.out);
+    memset(&ansi, 0, sizeof(ansi));
+}
+
+static void put_text(int y, int x, const char *text) {
+    if (y >= 0 && y < ansi.rows) {
+        Cell *row = &ansi.back[y * ansi.cols];
+        for (; *text && x < ansi.cols; text++, x++) {
+            if (x < 0) continue;
+            unsigned char ch = *text;
+            row[x].ch = ch >= 32 && ch < 127 ? (char)ch : '?';
+            row[x].attrs = current_attrs;
+        }
+    }
+    ansi.cursor_y = y;
+    ansi.cursor_x = x;
+}
+
+static void emit_attrs(int attrs) {
+    char seq[32] = "\x1b[0";
+    if (attrs & ATTR_BOLD) strcat(seq, ";1");
+    if (attrs & ATTR_DIM) strcat(seq, ";2");
+    if (attrs & ATTR_UNDERLINE) strcat(seq, ";4");
+    if (attrs & ATTR_REVERSE) strcat(seq, ";7");
+    out_str(seq);
+
+    int pair = attrs & 0xff;
+    if (pair > 0 && pair < MAX_PAIRS) {
+        out_printf(";3%d;4%d", ansi.fg[pair], ansi.bg[pair]);
+    }
+    out_str("m");
+}
+
+/*
+ * Move the hinted rows on the terminal inside a scroll region, and the front
+ * grid with them, so the diff only paints the rows that scrolled into view.
+ * Line feed at the bottom margin and reverse index at the top work on every
+ * VT100-compatible terminal.
+ */
+static void apply_scroll(void) {
+    int top = ansi.scroll_top;
+    int bottom = ansi.scroll_bottom < ansi.rows ? ansi.scroll_bottom : ansi.rows;
+    int lines = ansi.scroll_lines;
+    int count = lines > 0 ? lines : -lines;
+    ansi.scroll_lines = 0;
+    if (top < 0 || count == 0 || count >= bottom - top) return;
+
+    /* Reset attributes first: the lines scrolled in take the current background */
+    out_printf("\x1b[0m\x1b[%d;%dr\x1b[%d;1H", top + 1, bottom, lines > 0 ? bottom : top + 1);
+    for (int i = 0; i < count; i++) out_str(lines > 0 ? "\n" : "\x1bM");
+    out_str("\x1b[r");
+
+    Cell *region = &ansi.front[top * ansi.cols];
+    int kept = (bottom - top - count) * ansi.cols;
+    if (lines > 0) {
+        memmove(region, region + count * ansi.cols, kept * sizeof(Cell));
+        fill_cells(region + kept, count * ansi.cols, BLANK_ATTRS);
+    } else {
+        memmove(region + count * ansi.cols, region, kept * sizeof(Cell));
+        fill_cells(region, count * ansi.cols, BLANK_ATTRS);
+    }
+    stats.scrolls++;
+}
+
+/*
+ * Write every cell that differs from the previous frame. The cursor is only
+ * moved across gaps; short gaps in the current attributes are cheaper to
+ * rewrite than to jump over.
+ */
+static void ansi_present(void) {
+    size_t pending = ansi.out_len;  /* e.g. the clear after a resize */
+    if (stats.synchronized) out_str("\x1b[?2026h");
+    size_t frame_start = ansi.out_len;
+    if (ansi.scroll_lines) apply_scroll();
+
+    int term_y = -1;
+    int term_x = -1;
+    int term_attrs = -1;
+    for (int y = 0; y < ansi.rows; y++) {
+        const Cell *back = &ansi.back[y * ansi.cols];
+        const Cell *front = &ansi.front[y * ansi.cols];
+
+        for (int x = 0; x < ansi.cols; x++) {
+            if (back[x].ch == front[x].ch && back[x].attrs == front[x].attrs) continue;
+
+            if (y == term_y && x > term_x && x - term_x <= MAX_CURSOR_GAP) {
+                int gap = term_x;
+                while (gap < x && back[gap].attrs == term_attrs) gap++;
+                if (gap == x) {
+                    for (gap = term_x; gap < x; gap++) out_bytes(&back[gap].ch, 1);
+                    term_x = x;
+                }
+            }
+            if (y != term_y || x != term_x) out_printf("\x1b[%d;%dH", y + 1, x + 1);
+            if (back[x].attrs != term_attrs) {
+                emit_attrs(back[x].attrs);
+                term_attrs = back[x].attrs;
+            }
+            out_bytes(&back[x].ch, 1);
+            term_y = y;
+            term_x = x + 1;
+        }
+    }
+
+    if (ansi.out_len == frame_start) {
+        /* Nothing changed: write nothing, not even the synchronized update */
+        ansi.out_len = pending;
+        if (pending) out_flush();
+        return;
+    }
+    if (stats.synchronized) out_str("\x1b[?2026l");
+    memcpy(ansi.front, ansi.back, ansi.rows * ansi.cols * sizeof(Cell));
+    out_flush();
+}
+
+/* Read whatever input is waiting, after up to timeout_ms. Returns: 1 if some arrived */
+static int fill_input(int timeout_ms) {
+    if (ansi.in_len == (int)sizeof(ansi.in)) return 0;
+    if (timeout_ms > 0 && !wait_input(timeout_ms)) return 0;
+
+    ssize_t n = read(STDIN_FILENO, ansi.in + ansi.in_len, sizeof(ansi.in) - ansi.in_len);
+    if (n <= 0) return 0;
+    ansi.in_len += n;
+    return 1;
+}
+
+static int ss3_key(unsigned char final) {
+    switch (final) {
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
+        default:  return ERR;
+    }
+}
+
+static int tilde_key(int param) {
+    switch (param) {
+        case 1: case 7: return KEY_HOME;
+        case 4: case 8: return KEY_END;
+        case 3: return KEY_DC;
+        case 5: return KEY_PPAGE;
+        case 6: return KEY_NPAGE;
+        default: return ERR;
+    }
+}
+
+/*
+ * Decode the key at the front of the input buffer into ncurses' KEY_* codes.
+ * Returns: the key, with its length in *len; KEY_INCOMPLETE if more bytes
+ *          are needed; ERR for a sequence that is not a key, such as a late
+ *          reply to the terminal query
+ */
+static int decode_key(int *len) {
+    const unsigned char *in = ansi.in;
+    int n = ansi.in_len;
+
+    *len = 1;
+    if (in[0] != 27) return in[0];
+    if (n < 2) return KEY_INCOMPLETE;
+
+    if (in[1] == 'O') {
+        if (n < 3) return KEY_INCOMPLETE;
+        *len = 3;
+        return ss3_key(in[2]);
+    }
+    if (in[1] != '[') return 27;  /* Escape, then an ordinary key */
+
+    /* CSI: parameter and intermediate bytes, then the final byte */
+    int i = 2;
+    while (i < n && in[i] >= 0x20 && in[i] <= 0x3f) i++;
+    if (i == n) return KEY_INCOMPLETE;
+    *len = i + 1;
+
+    if (in[i] == '~') {
+        int param = 0;
+        for (int j = 2; j < i && in[j] >= '0' && in[j] <= '9'; j++) param = param * 10 + in[j] - '0';
+        return tilde_key(param);
+    }
+    return ss3_key(in[i]);
+}
+
+static int ansi_getch(void) {
+    for (;;) {
+        if (ansi.in_len == 0 && !fill_input(0)) return ERR;
+
+        int len;
+        int key = decode_key(&len);
+        if (key == KEY_INCOMPLETE && !fill_input(0) && !fill_input(ESC_DELAY_MS)) {
+            /* The rest never came: it was a lone Escape */
+            key = 27;
+            len = 1;
+        }
+        if (key == KEY_INCOMPLETE) continue;
+
+        ansi.in_len -= len;
+        memmove(ansi.in, ansi.in + len, ansi.in_len);
+        if (key != ERR) return key;
+    }
+}
+
+/* ========== Public Interface ========== */
+
+int render_init(RenderBackend which) {
+    backend = which;
+    memset(&stats, 0, sizeof(stats));
+    return backend == BACKEND_ANSI ? ansi_init() : curses_init();
+}
+
+void render_end(void) {
+    if (backend == BACKEND_ANSI) {
+        ansi_end();
+    } else {
+        endwin();
+    }
+}
+
+void render_init_pair(int pair, int fg, int bg) {
+    if (backend == BACKEND_ANSI) {
+        if (pair <= 0 || pair >= MAX_PAIRS) return;
+        ansi.fg[pair] = (unsigned char)fg;
+        ansi.bg[pair] = (unsigned char)bg;
+    } else if (has_colors()) {
+        init_pair(pair, fg, bg);
+    }
+}
+
+void render_size(int *rows, int *cols) {
+    if (backend == BACKEND_ANSI) {
+        *rows = ansi.rows;
+        *cols = ansi.cols;
+    } else {
+        getmaxyx(stdscr, *rows, *cols);
+    }
+}
+
+void render_resize(void) {
+    if (backend == BACKEND_ANSI) {
+        size_grids();
+    } else {
+        /* resizeterm() only reallocates the screens; endwin() and refresh()
+         * would also restart the terminal and repaint everything twice */
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+            resizeterm(ws.ws_row, ws.ws_col);
+        } else {
+            endwin();
+            refresh();
+        }
+    }
+}
+
+void render_erase(void) {
+    frame_start_ns = monotonic_ns();
+    if (backend == BACKEND_ANSI) {
+        fill_cells(ansi.back, ansi.rows * ansi.cols, BLANK_ATTRS);
+    } else {
+        erase();
+    }
+}
+
+void render_attron(int attrs) {
+    if (attrs & 0xff) current_attrs &= ~0xff;
+    current_attrs |= attrs;
+    if (backend == BACKEND_NCURSES) attron(curses_attrs(attrs));
+}
+
+void render_attroff(int attrs) {
+    current_attrs &= ~(attrs | (attrs & 0xff ? 0xff : 0));
+    if (backend == BACKEND_NCURSES) attroff(curses_attrs(attrs));
+}
+
+void render_print(int y, int x, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (backend == BACKEND_ANSI) {
+        char text[1024];
+        vsnprintf(text, sizeof(text), fmt, ap);
+        put_text(y, x, text);
+    } else {
+        move(y, x);
+        vw_printw(stdscr, fmt, ap);
+    }
+    va_end(ap);
+}
+
+void render_append(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (backend == BACKEND_ANSI) {
+        char text[1024];
+        vsnprintf(text, sizeof(text), fmt, ap);
+        put_text(ansi.cursor_y, ansi.cursor_x, text);
+    } else {
+        vw_printw(stdscr, fmt, ap);
+    }
+    va_end(ap);
+}
+
+void render_scroll(int top, int bottom, int lines) {
+    if (backend != BACKEND_ANSI || lines == 0) return;
+
+    /* One region per frame; a second one is left to the diff */
+    if (ansi.scroll_lines && (top != ansi.scroll_top || bottom != ansi.scroll_bottom)) return;
+    ansi.scroll_top = top;
+    ansi.scroll_bottom = bottom;
+    ansi.scroll_lines += lines;
+}
+
+void render_hline(int y, int x, char ch, int count) {
+    if (backend == BACKEND_NCURSES) {
+        mvhline(y, x, ch, count);
+        return;
+    }
+    if (y < 0 || y >= ansi.rows) return;
+    Cell *row = &ansi.back[y * ansi.cols];
+    for (int i = x < 0 ? 0 : x; i < x + count && i < ansi.cols; i++) {
+        row[i].ch = ch;
+        row[i].attrs = current_attrs;
+    }
+}
+
+void render_present(void) {
+    stats.last_frame_bytes = 0;
+    if (backend == BACKEND_ANSI) {
+        ansi_present();
+    } else {
+        refresh();
+    }
+    stats.frames++;
+    stats.last_frame_ns = monotonic_ns() - frame_start_ns;
+}
+
+int render_getch(void) {
+    return backend == BACKEND_ANSI ? ansi_getch() : getch();
+}
+
+const RenderStats* render_stats(void) {
+    return &stats;
+}
+
+const char* backend_name(RenderBackend which) {
+    return which == BACKEND_ANSI ? "ansi" : "ncurses";
+}
+
+int parse_backend(const char *name, RenderBackend *which) {
+    if (strcmp(name, "ansi") == 0) {
+        *which = BACKEND_ANSI;
+    } else if (strcmp(name, "ncurses") == 0) {
+        *which = BACKEND_NCURSES;
+    } else {
+        return -1;
+    }
+    return 0;
+}
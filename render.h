@@ -0,0 +1,87 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ncurses.h>  /* KEY_* codes and ERR, used by both backends */
+
+/* ========== Renderer ========== */
+
+/*
+ * Everything the draw_* functions put on screen goes through here. The
+ * ncurses backend forwards each call. The ANSI backend keeps its own grid
+ * of cells, diffs it against the previous frame and writes only the changed
+ * cells, as one write() per frame inside a synchronized update when the
+ * terminal supports one. It reads and decodes keys itself, so ncurses is
+ * never initialised.
+ */
+typedef enum {
+    BACKEND_NCURSES,
+    BACKEND_ANSI
+} RenderBackend;
+
+/* Attributes: a color pair from render_init_pair() plus style bits */
+#define ATTR_PAIR(n)    ((n) & 0xff)
+#define ATTR_BOLD       0x100
+#define ATTR_DIM        0x200
+#define ATTR_REVERSE    0x400
+#define ATTR_UNDERLINE  0x800
+
+typedef struct {
+    unsigned long frames;
+    uint64_t last_frame_ns;    /* From render_erase() to the end of render_present() */
+    size_t last_frame_bytes;   /* Bytes written; ANSI only, ncurses output is not counted */
+    int synchronized;          /* The terminal takes synchronized updates (mode 2026) */
+    unsigned long scrolls;     /* Frames that moved rows with a scroll region; ANSI only */
+} RenderStats;
+
+/* Take over the terminal. Returns: -1 if it could not be set up */
+int render_init(RenderBackend backend);
+
+/* Give the terminal back as it was */
+void render_end(void);
+
+/* Colors are the COLOR_* numbers, which match the ANSI palette */
+void render_init_pair(int pair, int fg, int bg);
+
+void render_size(int *rows, int *cols);
+
+/* Pick up a new terminal size; the next frame is painted in full */
+void render_resize(void);
+
+/* Start a frame with a blank screen */
+void render_erase(void);
+
+void render_attron(int attrs);
+void render_attroff(int attrs);
+
+/* printf at (y, x), clipped at the right edge */
+void render_print(int y, int x, const char *fmt, ...);
+
+/* printf where the last print stopped */
+void render_append(const char *fmt, ...);
+
+void render_hline(int y, int x, char ch, int count);
+
+/*
+ * Hint that rows top..bottom-1 of this frame show what the last frame showed,
+ * moved up by lines (down if negative). The ANSI backend scrolls them on the
+ * terminal and paints only the rows that came into view; ncurses finds moved
+ * lines by itself.
+ */
+void render_scroll(int top, int bottom, int lines);
+
+/* Put the frame on the terminal */
+void render_present(void);
+
+/* Returns: the next key, or ERR if none is waiting */
+int render_getch(void);
+
+const RenderStats* render_stats(void);
+
+const char* backend_name(RenderBackend backend);
+
+/* Returns: -1 if name is not a backend */
+int parse_backend(const char *name, RenderBackend *backend);
+
+#endif /* RENDER_H */
@@ -0,0 +1,256 @@
+#include "smaps.h"
+#include "survival.h"
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Lines are parsed in place; a mapping's name lives here until it is interned */
+static char buffer[SMAPS_BUFFER_SIZE];
+
+/* ========== Parsing ========== */
+
+static int grow_samples(MappingTracker *tracker, int new_capacity) {
+    if (heap_frozen) return -1;
+
+    MappingSample *mappings = realloc(tracker->mappings, new_capacity * sizeof(MappingSample));
+    if (!mappings) return -1;
+    tracker->mappings = mappings;
+
+    MappingSample *previous = realloc(tracker->previous, new_capacity * sizeof(MappingSample));
+    if (!previous) return -1;
+    tracker->previous = previous;
+
+    int *order = realloc(tracker->order, new_capacity * sizeof(int));
+    if (!order) return -1;
+    tracker->order = order;
+
+    tracker->capacity = new_capacity;
+    return 0;
+}
+
+/*
+ * "start-end perms offset dev inode   name". Header lines are the only ones
+ * starting with a lowercase hex digit; field names are capitalised.
+ * Returns: -1 on allocation failure
+ */
+static int parse_header(MappingTracker *tracker, char *line) {
+    char *p;
+    uint64_t start = strtoull(line, &p, 16);
+    if (*p != '-') return 0;
+    uint64_t end = strtoull(p + 1, &p, 16);
+
+    /* Skip perms, offset, dev and inode; the name, if any, follows the padding */
+    for (int field = 0; field < 4 && p; field++) {
+        while (*p == ' ') p++;
+        p = strchr(p, ' ');
+    }
+    const char *name = "";
+    if (p) {
+        while (*p == ' ') p++;
+        name = p;
+    }
+
+    if (tracker->count == tracker->capacity &&
+        grow_samples(tracker, tracker->capacity ? tracker->capacity * 2 : 1024) < 0) {
+        return -1;
+    }
+    int name_id = intern_string(&tracker->names, name);
+    if (name_id < 0) return -1;
+
+    MappingSample *mapping = &tracker->mappings[tracker->count++];
+    mapping->start = start;
+    mapping->end = end;
+    mapping->name_id = name_id;
+    mapping->rss_kb = 0;
+    mapping->first_kb = 0;
+    mapping->change_kb = 0;
+    return 0;
+}
+
+static int parse_line(MappingTracker *tracker, char *line) {
+    if ((*line >= '0' && *line <= '9') || (*line >= 'a' && *line <= 'f')) {
+        return parse_header(tracker, line);
+    }
+    if (tracker->count > 0 && strncmp(line, "Rss:", 4) == 0) {
+        tracker->mappings[tracker->count - 1].rss_kb = strtoul(line + 4, NULL, 10);
+    }
+    return 0;
+}
+
+/* Read smaps a buffer at a time; a line cut by the buffer's end moves to its front */
+static int read_smaps(MappingTracker *tracker) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/smaps", tracker->pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    tracker->count = 0;
+    tracker->bytes_read = 0;
+    size_t have = 0;
+    for (;;) {
+        ssize_t got = read(fd, buffer + have, sizeof(buffer) - 1 - have);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        tracker->bytes_read += got;
+        have += got;
+
+        char *line = buffer;
+        char *end = buffer + have;
+        char *newline;
+        while ((newline = memchr(line, '\n', end - line)) != NULL) {
+            *newline = '\0';
+            if (parse_line(tracker, line) < 0) {
+                close(fd);
+                errno = ENOMEM;
+                return -1;
+            }
+            line = newline + 1;
+        }
+        have = end - line;
+        memmove(buffer, line, have);
+
+        /* A line longer than the buffer cannot be a mapping we understand */
+        if (have == sizeof(buffer) - 1) have = 0;
+        if (got == 0) break;
+    }
+    close(fd);
+
+    if (have > 0) {
+        buffer[have] = '\0';
+        if (parse_line(tracker, buffer) < 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* ========== Diffing ========== */
+
+/* Walk both samples in address order, carrying each surviving mapping's baseline */
+static void diff_samples(MappingTracker *tracker) {
+    int first = tracker->samples == 0;
+    int old = 0;
+
+    tracker->rss_kb = 0;
+    for (int i = 0; i < tracker->count; i++) {
+        MappingSample *mapping = &tracker->mappings[i];
+        tracker->rss_kb += mapping->rss_kb;
+
+        while (old < tracker->previous_count && tracker->previous[old].start < mapping->start) {
+            tracker->removed++;
+            tracker->removed_growth_kb += mapping_growth_kb(&tracker->previous[old]);
+            old++;
+        }
+        if (old < tracker->previous_count && tracker->previous[old].start == mapping->start &&
+            tracker->previous[old].name_id == mapping->name_id) {
+            mapping->first_kb = tracker->previous[old].first_kb;
+            mapping->change_kb = (long)mapping->rss_kb - (long)tracker->previous[old].rss_kb;
+            old++;
+        } else {
+            /* New since the last sample; at the first sample everything is the baseline */
+            if (old < tracker->previous_count && tracker->previous[old].start == mapping->start) {
+                tracker->removed++;
+                tracker->removed_growth_kb += mapping_growth_kb(&tracker->previous[old]);
+                old++;
+            }
+            mapping->first_kb = first ? mapping->rss_kb : 0;
+            mapping->change_kb = first ? 0 : (long)mapping->rss_kb;
+            if (!first) tracker->created++;
+        }
+    }
+    for (; old < tracker->previous_count; old++) {
+        tracker->removed++;
+        tracker->removed_growth_kb += mapping_growth_kb(&tracker->previous[old]);
+    }
+    if (first) tracker->first_rss_kb = tracker->rss_kb;
+}
+
+/* qsort() has no context argument, so the comparator reads the tracker from here */
+static const MappingTracker *rank_tracker;
+
+static int compare_growth_desc(const void *a, const void *b) {
+    const MappingSample *ma = &rank_tracker->mappings[*(const int *)a];
+    const MappingSample *mb = &rank_tracker->mappings[*(const int *)b];
+    long ga = mapping_growth_kb(ma);
+    long gb = mapping_growth_kb(mb);
+    if (ga != gb) return ga < gb ? 1 : -1;
+    if (ma->rss_kb != mb->rss_kb) return ma->rss_kb < mb->rss_kb ? 1 : -1;
+    return (ma->start > mb->start) - (ma->start < mb->start);
+}
+
+static int take_sample(MappingTracker *tracker) {
+    uint64_t start = monotonic_ns();
+
+    /* The last sample becomes the previous one; parsing fills the other array */
+    MappingSample *swap = tracker->previous;
+    tracker->previous = tracker->mappings;
+    tracker->mappings = swap;
+    tracker->previous_count = tracker->count;
+
+    if (read_smaps(tracker) < 0) {
+        int saved = errno;
+        swap = tracker->previous;
+        tracker->previous = tracker->mappings;
+        tracker->mappings = swap;
+        tracker->count = tracker->previous_count;
+        tracker->error = saved;
+        tracker->sampled_ns = start;
+        errno = saved;
+        return -1;
+    }
+    diff_samples(tracker);
+
+    for (int i = 0; i < tracker->count; i++) tracker->order[i] = i;
+    rank_tracker = tracker;
+    qsort(tracker->order, tracker->count, sizeof(int), compare_growth_desc);
+
+    tracker->samples++;
+    tracker->error = 0;
+    tracker->sampled_ns = start;
+    tracker->parse_ns = monotonic_ns() - start;
+    return 1;
+}
+
+/* ========== Public Interface ========== */
+
+int mapping_tracker_start(MappingTracker *tracker, int pid) {
+    memset(tracker, 0, sizeof(*tracker));
+    if (heap_frozen) {
+        errno = ENOMEM;
+        return -1;
+    }
+    tracker->pid = pid;
+    intern_init(&tracker->names);
+    if (take_sample(tracker) < 0) {
+        int saved = errno;
+        mapping_tracker_stop(tracker);
+        errno = saved;
+        return -1;
+    }
+    tracker->active = 1;
+    tracker->started_ns = tracker->sampled_ns;
+    return 0;
+}
+
+void mapping_tracker_stop(MappingTracker *tracker) {
+    free(tracker->mappings);
+    free(tracker->previous);
+    free(tracker->order);
+    intern_free(&tracker->names);
+    memset(tracker, 0, sizeof(*tracker));
+}
+
+int mapping_tracker_poll(MappingTracker *tracker) {
+    if (!tracker->active || monotonic_ns() - tracker->sampled_ns < SMAPS_PERIOD_NS) return 0;
+    return take_sample(tracker);
+}
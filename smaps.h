@@ -0,0 +1,70 @@
+#ifndef SMAPS_H
+#define SMAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
+
+/* ========== Mapping Growth ========== */
+
+/*
+ * Which mappings of one process are growing. /proc/[pid]/smaps is read
+ * every SMAPS_PERIOD_NS through a fixed buffer, a line at a time, keeping
+ * only each mapping's range, name and RSS. Since the file lists mappings in
+ * address order, a sample is diffed against the previous one with a single
+ * merge walk. A mapping is the same one if its start and name are unchanged,
+ * so the heap growing at its end still counts as one. The cost stays linear
+ * in the number of mappings, even for a JVM with tens of thousands of them.
+ */
+
+#define SMAPS_PERIOD_NS (10ULL * 1000000000ULL)
+#define SMAPS_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    int name_id;               /* Interned path or pseudo-name; "" for anonymous memory */
+    unsigned long rss_kb;
+    unsigned long first_kb;    /* RSS at the first sample, 0 for mappings created since */
+    long change_kb;            /* Since the previous sample */
+} MappingSample;
+
+typedef struct {
+    int active;
+    int pid;
+    uint64_t started_ns;
+    uint64_t sampled_ns;
+    int samples;
+    int error;                 /* errno of the last failed sample, 0 = none */
+
+    MappingSample *mappings;   /* Latest sample, by address */
+    MappingSample *previous;
+    int count;
+    int previous_count;
+    int capacity;
+    int *order;                /* Mapping indices, most growth first */
+    InternTable names;
+
+    unsigned long rss_kb;          /* Across all mappings */
+    unsigned long first_rss_kb;
+    int created;                   /* Mappings that appeared since the first sample */
+    int removed;                   /* ... and that went away */
+    long removed_growth_kb;        /* Growth those had at their last sample */
+
+    uint64_t parse_ns;             /* Time the last sample took */
+    size_t bytes_read;
+} MappingTracker;
+
+/* Start watching pid and take the first sample. Returns: -1 with errno set */
+int mapping_tracker_start(MappingTracker *tracker, int pid);
+void mapping_tracker_stop(MappingTracker *tracker);
+
+/* Sample again if SMAPS_PERIOD_NS has passed. Returns: 1 if sampled, 0 if not due, -1 with errno set */
+int mapping_tracker_poll(MappingTracker *tracker);
+
+/* Growth of a mapping since the first sample, or since it appeared */
+static inline long mapping_growth_kb(const MappingSample *mapping) {
+    return (long)mapping->rss_kb - (long)mapping->first_kb;
+}
+
+#endif /* SMAPS_H */
@@ -0,0 +1,151 @@
+#include "snapshot.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "timing.h"
+#include "survival.h"
+
+#define SNAPSHOT_BLOCK_SIZE (256 * 1024)
+#define INITIAL_TASK_CAPACITY 1024
+
+/* Every snapshot ever created, for stats and teardown */
+static Snapshot **all_snapshots = NULL;
+static int all_count = 0;
+static Snapshot *free_list = NULL;
+static int free_count = 0;
+
+/* Largest table seen so far; new tables start at this size to avoid regrowth */
+static int task_capacity_hint = INITIAL_TASK_CAPACITY;
+
+/* ========== Pool ========== */
+
+Snapshot* snapshot_acquire(void) {
+    Snapshot *snapshot = free_list;
+
+    if (snapshot) {
+        free_list = snapshot->next_free;
+        free_count--;
+    } else {
+        if (heap_frozen) return NULL;
+        Snapshot **grown = realloc(all_snapshots, (all_count + 1) * sizeof(Snapshot*));
+        if (!grown) return NULL;
+        all_snapshots = grown;
+
+        snapshot = calloc(1, sizeof(Snapshot));
+        if (!snapshot) return NULL;
+        arena_init(&snapshot->arena, SNAPSHOT_BLOCK_SIZE);
+        intmap_init(&snapshot->by_tid);
+        all_snapshots[all_count++] = snapshot;
+    }
+
+    snapshot->tasks = NULL;
+    snapshot->count = 0;
+    snapshot->capacity = 0;
+    snapshot->next_free = NULL;
+    snapshot->taken_ns = monotonic_ns();
+    intmap_reset(&snapshot->by_tid, 0);
+    return snapshot;
+}
+
+void snapshot_release(Snapshot *snapshot) {
+    if (!snapshot) return;
+
+    arena_reset(&snapshot->arena);
+    snapshot->tasks = NULL;
+    snapshot->count = 0;
+    snapshot->capacity = 0;
+
+    snapshot->next_free = free_list;
+    free_list = snapshot;
+    free_count++;
+}
+
+int snapshot_pool_reserve(int count, int max_tasks, size_t string_bytes) {
+    /* Create the snapshots first, holding each so the next acquire makes a new one */
+    Snapshot *held = NULL;
+    while (all_count < count) {
+        Snapshot *snapshot = snapshot_acquire();
+        if (!snapshot) break;
+        snapshot->next_free = held;
+        held = snapshot;
+    }
+    while (held) {
+        Snapshot *next = held->next_free;
+        snapshot_release(held);
+        held = next;
+    }
+    if (all_count < count) return -1;
+
+    /* Tables are created at exactly this size and never grow afterwards */
+    task_capacity_hint = max_tasks;
+    for (int i = 0; i < all_count; i++) {
+        Snapshot *snapshot = all_snapshots[i];
+        size_t bytes = task_capacity_hint * sizeof(TaskInfo) + string_bytes;
+        if (arena_reserve(&snapshot->arena, bytes) < 0) return -1;
+        if (snapshot->count == 0 && intmap_reset(&snapshot->by_tid, max_tasks) < 0) return -1;
+    }
+    return 0;
+}
+
+void snapshot_pool_destroy(void) {
+    for (int i = 0; i < all_count; i++) {
+        arena_free(&all_snapshots[i]->arena);
+        intmap_free(&all_snapshots[i]->by_tid);
+        free(all_snapshots[i]);
+    }
+    free(all_snapshots);
+    all_snapshots = NULL;
+    all_count = 0;
+    free_list = NULL;
+    free_count = 0;
+}
+
+/* ========== Task Table ========== */
+
+TaskInfo* snapshot_add_task(Snapshot *snapshot) {
+    if (snapshot->count == snapshot->capacity) {
+        /* Survival mode: a full table truncates the snapshot, leaving the
+         * rest of the arena for command lines */
+        if (heap_frozen && snapshot->capacity) return NULL;
+
+        /* The old table stays in the arena until reset; the sizing hint keeps
+         * this to the first refreshes after startup or a burst of new tasks */
+        int new_capacity = snapshot->capacity ? snapshot->capacity * 2 : task_capacity_hint;
+        TaskInfo *grown = arena_alloc(&snapshot->arena, new_capacity * sizeof(TaskInfo));
+        if (!grown) return NULL;
+
+        if (snapshot->count > 0) {
+            memcpy(grown, snapshot->tasks, snapshot->count * sizeof(TaskInfo));
+        }
+        snapshot->tasks = grown;
+        snapshot->capacity = new_capacity;
+        if (new_capacity > task_capacity_hint) task_capacity_hint = new_capacity;
+    }
+
+    return &snapshot->tasks[snapshot->count++];
+}
+
+int snapshot_build_index(Snapshot *snapshot) {
+    if (intmap_reset(&snapshot->by_tid, snapshot->count) < 0) return -1;
+    for (int i = 0; i < snapshot->count; i++) {
+        intmap_put(&snapshot->by_tid, snapshot->tasks[i].tid, i);
+    }
+    return 0;
+}
+
+/* ========== Statistics ========== */
+
+void snapshot_get_stats(SnapshotStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->allocated = all_count;
+    stats->free = free_count;
+
+    for (int i = 0; i < all_count; i++) {
+        const Arena *arena = &all_snapshots[i]->arena;
+        stats->arena_used += arena->used;
+        stats->arena_reserved += arena->reserved;
+        if (arena->high_water > stats->arena_high_water) {
+            stats->arena_high_water = arena->high_water;
+        }
+    }
+}
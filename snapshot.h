@@ -0,0 +1,66 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include "arena.h"
+#include "intmap.h"
+#include "task_data.h"
+
+/* ========== Snapshots ========== */
+
+/*
+ * One refresh worth of task data. The task table and every variable-length
+ * field hanging off it live in the snapshot's arena, so releasing a
+ * snapshot is a single arena reset.
+ */
+typedef struct Snapshot {
+    TaskInfo *tasks;
+    int count;
+    int capacity;
+    uint64_t taken_ns;             /* Monotonic time the collection started */
+    IntMap by_tid;                 /* tid -> row, valid after snapshot_build_index() */
+    Arena arena;
+    struct Snapshot *next_free;    /* Pool link while released */
+} Snapshot;
+
+/* Pool statistics for the debug panel */
+typedef struct {
+    int allocated;                 /* Snapshots ever created */
+    int free;                      /* Currently waiting in the pool */
+    size_t arena_used;             /* Sum over live snapshots */
+    size_t arena_reserved;         /* Sum over all snapshots */
+    size_t arena_high_water;       /* Largest single-snapshot high-water mark */
+} SnapshotStats;
+
+/* Take an empty snapshot from the pool, creating one if the pool is empty */
+Snapshot* snapshot_acquire(void);
+
+/* Return a snapshot to the pool; its data is discarded in O(1) */
+void snapshot_release(Snapshot *snapshot);
+
+/* Append an uninitialised task, growing the table inside the arena
+ * Returns: the new task, or NULL on allocation failure
+ */
+TaskInfo* snapshot_add_task(Snapshot *snapshot);
+
+/* Index the collected tasks by tid. Returns: -1 on allocation failure */
+int snapshot_build_index(Snapshot *snapshot);
+
+/* Returns: the row of tid, or -1 */
+static inline int snapshot_find_tid(const Snapshot *snapshot, int tid) {
+    return intmap_get(&snapshot->by_tid, tid);
+}
+
+void snapshot_get_stats(SnapshotStats *stats);
+
+/*
+ * Size the pool for survival mode: at least count snapshots, each able to
+ * hold max_tasks tasks and string_bytes of command lines without growing.
+ * Call before the first collection. Returns: -1 on allocation failure
+ */
+int snapshot_pool_reserve(int count, int max_tasks, size_t string_bytes);
+
+/* Free every pooled and live snapshot (at exit) */
+void snapshot_pool_destroy(void);
+
+#endif /* SNAPSHOT_H */
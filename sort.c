@@ -0,0 +1,302 @@
+#include "sort.h"
+#include "survival.h"
+#include <stdlib.h>
+
+/* Below this size insertion sort beats the fixed cost of the radix histograms */
+#define INSERTION_SORT_THRESHOLD 32
+
+/* The adaptive path gives up when more than 1/N of the rows are out of place */
+#define ADAPTIVE_DISORDER_DIVISOR 8
+
+/* ========== Scratch Management ========== */
+
+void sort_engine_init(SortEngine *engine) {
+    memset(engine, 0, sizeof(*engine));
+}
+
+void sort_engine_free(SortEngine *engine) {
+    free(engine->pairs);
+    free(engine->scratch);
+    free(engine->displaced);
+    free(engine->kept);
+    memset(engine, 0, sizeof(*engine));
+}
+
+/* Grow the buffers geometrically; once they fit the host, this never allocates */
+int sort_engine_reserve(SortEngine *engine, int count) {
+    if (count <= engine->capacity) return 0;
+    if (heap_frozen) return -1;
+
+    int new_capacity = engine->capacity ? engine->capacity : 1024;
+    while (new_capacity < count) new_capacity *= 2;
+
+    SortPair *pairs = realloc(engine->pairs, new_capacity * sizeof(SortPair));
+    if (!pairs) return -1;
+    engine->pairs = pairs;
+
+    SortPair *scratch = realloc(engine->scratch, new_capacity * sizeof(SortPair));
+    if (!scratch) return -1;
+    engine->scratch = scratch;
+
+    SortPair *displaced = realloc(engine->displaced, new_capacity * sizeof(SortPair));
+    if (!displaced) return -1;
+    engine->displaced = displaced;
+
+    uint32_t *kept = realloc(engine->kept, new_capacity * sizeof(uint32_t));
+    if (!kept) return -1;
+    engine->kept = kept;
+
+    engine->capacity = new_capacity;
+    return 0;
+}
+
+/* ========== Key Encoding ========== */
+
+/* One key function and one key-filling loop per column, from the column table */
+#define SORT_KEY_FUNCTIONS(id, name, title, width, right_align, sortable, group, field, visible, tier, kind, value) \
+    static inline uint64_t key_##id(const TaskInfo *task) { \
+        return SORT_KEY_##kind(value); \
+    } \
+    static void fill_keys_##id(SortPair *pairs, const TaskInfo *tasks, const int *rows, int count, \
+                               uint64_t flip) { \
+        for (int i = 0; i < count; i++) { \
+            pairs[i].key = key_##id(&tasks[rows[i]]) ^ flip; \
+            pairs[i].row = rows[i]; \
+        } \
+    }
+
+COLUMN_TABLE(SORT_KEY_FUNCTIONS)
+COLUMN_TABLE_TAIL(SORT_KEY_FUNCTIONS)
+
+typedef uint64_t (*KeyFunction)(const TaskInfo *task);
+typedef void (*KeyFiller)(SortPair *pairs, const TaskInfo *tasks, const int *rows, int count, uint64_t flip);
+
+#define SORT_KEY_FUNCTION(id, ...) [id] = key_##id,
+#define SORT_KEY_FILLER(id, ...) [id] = fill_keys_##id,
+
+/* NULL for the plugin slots, whose type is only known at run time */
+static const KeyFunction key_functions[COLUMN_COUNT] = {
+    COLUMN_TABLE(SORT_KEY_FUNCTION)
+    COLUMN_TABLE_TAIL(SORT_KEY_FUNCTION)
+};
+
+static const KeyFiller key_fillers[COLUMN_COUNT] = {
+    COLUMN_TABLE(SORT_KEY_FILLER)
+    COLUMN_TABLE_TAIL(SORT_KEY_FILLER)
+};
+
+static uint64_t plugin_key(const TaskInfo *task, ColumnId key) {
+    PluginValue value = task->plugin_values[key - COL_PLUGIN_FIRST];
+    if (plugin_value_types[key - COL_PLUGIN_FIRST] == PLUGIN_NUMBER) {
+        return sort_encode_double(value.number);
+    }
+    return sort_encode_prefix(value.text);
+}
+
+/* Plugin values are typed per slot, so the type test is made once, outside the loop */
+static void fill_plugin_keys(SortPair *pairs, const TaskInfo *tasks, const int *rows, int count,
+                             ColumnId key, uint64_t flip) {
+    int slot = key - COL_PLUGIN_FIRST;
+
+    if (plugin_value_types[slot] == PLUGIN_NUMBER) {
+        for (int i = 0; i < count; i++) {
+            pairs[i].key = sort_encode_double(tasks[rows[i]].plugin_values[slot].number) ^ flip;
+            pairs[i].row = rows[i];
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            pairs[i].key = sort_encode_prefix(tasks[rows[i]].plugin_values[slot].text) ^ flip;
+            pairs[i].row = rows[i];
+        }
+    }
+}
+
+uint64_t sort_task_key(const TaskInfo *task, ColumnId key) {
+    if (is_plugin_column(key)) return plugin_key(task, key);
+    return key_functions[key](task);
+}
+
+/* ========== Radix Sort ========== */
+
+static void insertion_sort(SortPair *pairs, int count) {
+    for (int i = 1; i < count; i++) {
+        SortPair item = pairs[i];
+        int j = i - 1;
+        while (j >= 0 && pairs[j].key > item.key) {
+            pairs[j + 1] = pairs[j];
+            j--;
+        }
+        pairs[j + 1] = item;
+    }
+}
+
+/*
+ * LSD radix sort on 8-bit digits. All eight histograms are built in a single
+ * read pass, and a digit position where every key has the same byte is
+ * skipped, so 32-bit values like pids only pay for the passes they use.
+ */
+static void radix_sort(SortEngine *engine, SortPair *pairs, int count) {
+    uint32_t (*histogram)[256] = engine->histogram;
+    memset(engine->histogram, 0, sizeof(engine->histogram));
+
+    for (int i = 0; i < count; i++) {
+        uint64_t key = pairs[i].key;
+        for (int digit = 0; digit < 8; digit++) {
+            histogram[digit][(key >> (digit * 8)) & 0xff]++;
+        }
+    }
+
+    SortPair *src = pairs;
+    SortPair *dst = engine->scratch;
+
+    for (int digit = 0; digit < 8; digit++) {
+        int shift = digit * 8;
+        uint32_t *counts = histogram[digit];
+
+        if (counts[(src[0].key >> shift) & 0xff] == (uint32_t)count) continue;
+
+        uint32_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            uint32_t n = counts[b];
+            counts[b] = offset;
+            offset += n;
+        }
+
+        for (int i = 0; i < count; i++) {
+            dst[counts[(src[i].key >> shift) & 0xff]++] = src[i];
+        }
+
+        SortPair *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != pairs) {
+        memcpy(pairs, src, count * sizeof(SortPair));
+    }
+}
+
+int sort_pairs(SortEngine *engine, SortPair *pairs, int count) {
+    if (count < INSERTION_SORT_THRESHOLD) {
+        insertion_sort(pairs, count);
+        return 0;
+    }
+    if (sort_engine_reserve(engine, count) < 0) return -1;
+
+    radix_sort(engine, pairs, count);
+    return 0;
+}
+
+/* ========== Adaptive Re-sort ========== */
+
+/*
+ * One pass splits the input into a sorted subsequence that stays in place
+ * and a small set of displaced pairs. Whenever a pair is smaller than the
+ * last kept one, both are set aside, which keeps the displaced set within
+ * twice the number of rows that actually moved. Only positions are recorded
+ * until the merge, so the input is untouched if the pass gives up. The
+ * displaced pairs are then sorted on their own and merged back in, with
+ * ties going to whichever pair came first in the input.
+ */
+int sort_pairs_adaptive(SortEngine *engine, SortPair *pairs, int count) {
+    if (sort_engine_reserve(engine, count) < 0) return -1;
+
+    uint32_t *kept_at = engine->kept;
+    int kept = 0;
+    int moved = 0;
+    int limit = count / ADAPTIVE_DISORDER_DIVISOR;
+
+    for (int i = 0; i < count; i++) {
+        if (kept == 0 || pairs[i].key >= pairs[kept_at[kept - 1]].key) {
+            kept_at[kept++] = i;
+        } else {
+            kept--;
+            moved += 2;
+            if (moved > limit) break;
+        }
+    }
+
+    engine->last_displaced = moved;
+    engine->last_fallback = moved > limit;
+
+    if (engine->last_fallback) {
+        /* Too much disorder: the input is still in its original order, sort from scratch */
+        engine->fallback_count++;
+        return sort_pairs(engine, pairs, count);
+    }
+
+    if (moved == 0) return 0;
+
+    /* The positions not kept are the displaced ones; collecting them in input
+     * order and tagging each with its position makes the stable sort below
+     * order them by (key, position) */
+    SortPair *displaced = engine->displaced;
+    int n = 0;
+    for (int i = 0, a = 0; i < count; i++) {
+        if (a < kept && kept_at[a] == (uint32_t)i) {
+            a++;
+        } else {
+            displaced[n].key = pairs[i].key;
+            displaced[n].row = i;
+            n++;
+        }
+    }
+
+    /* sort_pairs() uses engine->scratch, so the displaced set sorts in place */
+    sort_pairs(engine, displaced, moved);
+
+    /* Merge by (key, position), so equal keys keep their input order */
+    SortPair *out = engine->scratch;
+    int a = 0, b = 0;
+    n = 0;
+    while (a < kept && b < moved) {
+        const SortPair *k = &pairs[kept_at[a]];
+        if (displaced[b].key < k->key ||
+            (displaced[b].key == k->key && displaced[b].row < kept_at[a])) {
+            out[n++] = pairs[displaced[b++].row];
+        } else {
+            out[n++] = *k;
+            a++;
+        }
+    }
+    while (a < kept) out[n++] = pairs[kept_at[a++]];
+    while (b < moved) out[n++] = pairs[displaced[b++].row];
+
+    memcpy(pairs, out, count * sizeof(SortPair));
+    return 0;
+}
+
+/* ========== Row Sorting ========== */
+
+static int sort_rows_with(int (*sorter)(SortEngine*, SortPair*, int),
+                          SortEngine *engine, const TaskInfo *tasks, int *rows, int count,
+                          ColumnId key, int descending) {
+    if (sort_engine_reserve(engine, count) < 0) return -1;
+
+    /* Descending order is ascending order of the complemented key */
+    uint64_t flip = descending ? ~0ULL : 0;
+    SortPair *pairs = engine->pairs;
+
+    if (is_plugin_column(key)) {
+        fill_plugin_keys(pairs, tasks, rows, count, key, flip);
+    } else {
+        key_fillers[key](pairs, tasks, rows, count, flip);
+    }
+
+    sorter(engine, pairs, count);
+
+    for (int i = 0; i < count; i++) {
+        rows[i] = pairs[i].row;
+    }
+    return 0;
+}
+
+int sort_rows(SortEngine *engine, const TaskInfo *tasks, int *rows, int count,
+              ColumnId key, int descending) {
+    return sort_rows_with(sort_pairs, engine, tasks, rows, count, key, descending);
+}
+
+int sort_rows_adaptive(SortEngine *engine, const TaskInfo *tasks, int *rows, int count,
+                       ColumnId key, int descending) {
+    return sort_rows_with(sort_pairs_adaptive, engine, tasks, rows, count, key, descending);
+}
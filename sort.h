@@ -0,0 +1,109 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdint.h>
+#include <string.h>
+#include "task_data.h"
+#include "user_cache.h"
+#include "columns.h"
+
+/* ========== Sort Keys ========== */
+
+/* A row index tagged with its encoded key; this is what the radix passes move */
+typedef struct {
+    uint64_t key;
+    uint32_t row;
+} SortPair;
+
+/* Scratch buffers are kept across refreshes, so steady-state sorting allocates nothing */
+typedef struct {
+    SortPair *pairs;
+    SortPair *scratch;
+    SortPair *displaced;         /* Out-of-order pairs pulled aside by the adaptive path */
+    uint32_t *kept;              /* Input positions of the pairs the adaptive path leaves in order */
+    int capacity;
+    uint32_t histogram[8][256];  /* One per radix digit */
+
+    /* Statistics from the last adaptive sort */
+    int last_displaced;
+    int last_fallback;           /* Disorder was too high, a full sort ran instead */
+    int fallback_count;
+} SortEngine;
+
+/* ========== Order-Preserving Key Encoding ========== */
+
+/*
+ * Each encoder maps a value to an unsigned integer whose natural order
+ * matches the value's order, so every column sorts with the same radix code.
+ */
+static inline uint64_t sort_encode_u64(uint64_t value) {
+    return value;
+}
+
+static inline uint64_t sort_encode_i64(int64_t value) {
+    return (uint64_t)value ^ 0x8000000000000000ULL;  /* Flip sign bit */
+}
+
+static inline uint64_t sort_encode_double(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    /* Negative: flip everything. Positive: flip the sign bit only */
+    return (bits & 0x8000000000000000ULL) ? ~bits : bits ^ 0x8000000000000000ULL;
+}
+
+/* First eight bytes, big-endian, so strings sort by their prefix; NULL first */
+static inline uint64_t sort_encode_prefix(const char *str) {
+    uint64_t key = 0;
+    for (int i = 0; i < 8; i++) {
+        unsigned char c = str ? (unsigned char)*str : 0;
+        key = key << 8 | c;
+        if (c) str++;
+    }
+    return key;
+}
+
+/* Encoder for each kind of the column table (see COLUMN_TABLE) */
+#define SORT_KEY_INT(value)       sort_encode_i64(value)
+#define SORT_KEY_PERCENT(value)   sort_encode_double(value)
+#define SORT_KEY_BYTES(value)     sort_encode_u64(value)
+#define SORT_KEY_BYTE_RATE(value) sort_encode_double(value)
+#define SORT_KEY_GROWTH(value)    sort_encode_double(value)
+#define SORT_KEY_USER(value)      intern_rank(&user_names, value)
+#define SORT_KEY_COMMAND(value)   intern_rank(&command_names, value)
+#define SORT_KEY_STATE(value)     (uint64_t)(unsigned char)(value)
+#define SORT_KEY_TEXT(value)      sort_encode_prefix(value)
+#define SORT_KEY_WAIT(value)      intern_rank(&wait_channels, value)
+
+/* ========== Sort Engine Functions ========== */
+
+void sort_engine_init(SortEngine *engine);
+void sort_engine_free(SortEngine *engine);
+
+/* Size the scratch buffers for count rows up front. Returns: -1 on allocation failure */
+int sort_engine_reserve(SortEngine *engine, int count);
+
+/* Encoded key of one task for the given column */
+uint64_t sort_task_key(const TaskInfo *task, ColumnId key);
+
+/* Stable LSD radix sort of (key, row) pairs, in place */
+int sort_pairs(SortEngine *engine, SortPair *pairs, int count);
+
+/* Sort a list of row indices into tasks[] by key. Ties keep their input order
+ * Returns: 0 on success, -1 if scratch space could not be allocated
+ */
+int sort_rows(SortEngine *engine, const TaskInfo *tasks, int *rows, int count,
+              ColumnId key, int descending);
+
+/*
+ * Re-sort pairs that are already close to sorted, typically the previous
+ * frame's order with updated keys. Runs in near-linear time when few rows
+ * moved and falls back to a full radix sort when disorder is high.
+ * Ties keep their input order, so unchanged rows do not jump around.
+ */
+int sort_pairs_adaptive(SortEngine *engine, SortPair *pairs, int count);
+
+/* sort_rows() for rows seeded from the previous frame's order */
+int sort_rows_adaptive(SortEngine *engine, const TaskInfo *tasks, int *rows, int count,
+                       ColumnId key, int descending);
+
+#endif /* SORT_H */
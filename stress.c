@@ -0,0 +1,113 @@
+/*
+ * Local stress fixture for survival mode (not part of the release binary).
+ *
+ * Keeps a churning population of short-lived child processes, like a
+ * contained fork bomb, and optionally a child that keeps touching a large
+ * allocation to push the host into swap. Every child dies with the fixture.
+ *
+ *   ./stress_host -p 5000 -m 4096 -t 60 &
+ *   ./processexplorer -S 100000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#define MAX_PROCS 20000
+
+static volatile sig_atomic_t stop = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+/* Children go away with the fixture, even if it is killed */
+static void die_with_parent(void) {
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+}
+
+/* Short-lived child: sleep up to a second, then exit so the parent respawns */
+static void churn_child(void) {
+    die_with_parent();
+    struct timespec nap = {0, (rand() % 1000) * 1000000L};
+    nanosleep(&nap, NULL);
+    _exit(0);
+}
+
+/* Keep every page of a large buffer dirty so the kernel has to swap */
+static void memory_hog(size_t megabytes) {
+    die_with_parent();
+    size_t size = megabytes * 1024 * 1024;
+    char *buf = malloc(size);
+    if (!buf) _exit(1);
+
+    long page = sysconf(_SC_PAGESIZE);
+    for (unsigned char value = 0; ; value++) {
+        for (size_t i = 0; i < size; i += page) buf[i] = value;
+    }
+}
+
+int main(int argc, char **argv) {
+    int procs = 1000;
+    size_t megabytes = 0;
+    int seconds = 30;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:m:t:")) != -1) {
+        switch (opt) {
+            case 'p': procs = atoi(optarg); break;
+            case 'm': megabytes = strtoul(optarg, NULL, 10); break;
+            case 't': seconds = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-p procs] [-m megabytes] [-t seconds]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (procs < 0) procs = 0;
+    if (procs > MAX_PROCS) procs = MAX_PROCS;
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+    signal(SIGALRM, handle_stop);
+    alarm(seconds);
+
+    pid_t hog = megabytes > 0 ? fork() : -1;
+    if (hog == 0) memory_hog(megabytes);
+
+    printf("stress: %d churning processes, %zu MB hog, %d s\n", procs, megabytes, seconds);
+    fflush(stdout);
+
+    int alive = 0;
+    unsigned long spawned = 0;
+    while (!stop) {
+        while (alive < procs && !stop) {
+            pid_t pid = fork();
+            if (pid == 0) churn_child();
+            if (pid < 0) break;  /* Hit a process limit; retry after reaping */
+            alive++;
+            spawned++;
+        }
+
+        if (waitpid(-1, NULL, 0) > 0) alive--;
+    }
+
+    /* Churning children exit on their own within a second */
+    if (hog > 0) kill(hog, SIGKILL);
+    while (wait(NULL) > 0) {
+    }
+
+    printf("stress: spawned %lu processes\n", spawned);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "survival.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+/* Low real-time priority: above every normal task, below kernel helpers */
+#define SURVIVAL_FIFO_PRIORITY 10
+#define SURVIVAL_NICE -15
+
+int heap_frozen = 0;
+
+static SurvivalStatus status;
+
+#ifdef __linux__
+
+static void raise_priority(void) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = SURVIVAL_FIFO_PRIORITY;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) == 0) {
+        status.priority = PRIORITY_FIFO;
+        status.priority_value = SURVIVAL_FIFO_PRIORITY;
+        return;
+    }
+
+    /* Without CAP_SYS_NICE, take whatever nice level we are allowed */
+    for (int nice = SURVIVAL_NICE; nice < 0; nice++) {
+        if (setpriority(PRIO_PROCESS, 0, nice) == 0) {
+            status.priority = PRIORITY_NICE;
+            status.priority_value = nice;
+            return;
+        }
+    }
+}
+
+static void lock_memory(void) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+        status.locked = 1;
+    } else {
+        status.lock_errno = errno;
+    }
+}
+
+#else /* !__linux__ */
+
+static void raise_priority(void) {
+}
+
+static void lock_memory(void) {
+    status.lock_errno = ENOSYS;
+}
+
+#endif /* __linux__ */
+
+void survival_enter(void) {
+    /* localtime() opens the zone file on first use; do it now */
+    tzset();
+
+    status.active = 1;
+    raise_priority();
+    lock_memory();
+    heap_frozen = 1;
+}
+
+const SurvivalStatus* survival_status(void) {
+    return &status;
+}
+
+const char* priority_name(PriorityLevel priority) {
+    switch (priority) {
+        case PRIORITY_FIFO:   return "SCHED_FIFO";
+        case PRIORITY_NICE:   return "nice";
+        default:              return "normal";
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef SURVIVAL_H
+#define SURVIVAL_H
+
+/* ========== Survival Mode ========== */
+
+/*
+ * For watching a host that is thrashing or being fork-bombed. Everything the
+ * collector and renderer need is reserved up front and locked in RAM, the
+ * process runs at real-time (or at least raised) priority, and from then on
+ * every growable structure fails instead of allocating: a snapshot that does
+ * not fit is truncated rather than paged in.
+ */
+
+/* Set by survival_enter(); growth paths check it and fail instead of allocating */
+extern int heap_frozen;
+
+typedef enum {
+    PRIORITY_NORMAL,
+    PRIORITY_NICE,
+    PRIORITY_FIFO
+} PriorityLevel;
+
+typedef struct {
+    int active;
+    int locked;               /* mlockall() succeeded */
+    int lock_errno;
+    PriorityLevel priority;
+    int priority_value;       /* SCHED_FIFO priority or nice value */
+} SurvivalStatus;
+
+/*
+ * Raise scheduling priority, lock all current and future pages, and freeze
+ * the heap. Everything must already be reserved; failures to lock or raise
+ * priority (no privileges) are recorded, not fatal.
+ */
+void survival_enter(void);
+
+const SurvivalStatus* survival_status(void);
+
+const char* priority_name(PriorityLevel priority);
+
+#endif /* SURVIVAL_H */
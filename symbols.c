@@ -0,0 +1,339 @@
+#include "symbols.h"
+#include "survival.h"
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+
+/* Reload a process's mappings at most this often when addresses miss */
+#define RELOAD_INTERVAL_NS 500000000ULL
+
+#define MAX_LOAD_SEGMENTS 16
+
+typedef struct {
+    uint64_t start;
+    uint64_t size;
+    const char *name;       /* Into the mapped file's string table */
+} FunctionSymbol;
+
+typedef struct {
+    uint64_t offset;        /* PT_LOAD: file offset, virtual address and size */
+    uint64_t vaddr;
+    uint64_t size;
+} LoadSegment;
+
+typedef struct {
+    unsigned long long dev;
+    unsigned long long inode;
+    void *map;              /* The whole file, read-only; names point into it */
+    size_t size;
+    FunctionSymbol *symbols;
+    int count;
+    LoadSegment segments[MAX_LOAD_SEGMENTS];
+    int segment_count;
+} SymbolImage;
+
+static SymbolImage images[SYMBOL_MAX_IMAGES];
+static int image_count = 0;
+
+/* ========== ELF Files ========== */
+
+static int compare_symbols(const void *a, const void *b) {
+    const FunctionSymbol *x = a;
+    const FunctionSymbol *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/* Everything read from the file is bounds-checked: it may be truncated or not ELF at all */
+static int in_file(const SymbolImage *image, uint64_t offset, uint64_t size) {
+    return offset <= image->size && size <= image->size - offset;
+}
+
+/* Function symbols of .symtab, or of .dynsym for a stripped file. Returns: -1 if not usable */
+static int index_symbols(SymbolImage *image) {
+    const unsigned char *base = image->map;
+    const Elf64_Ehdr *header = image->map;
+
+    if (image->size < sizeof(Elf64_Ehdr) || memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 ||
+        header->e_ident[EI_CLASS] != ELFCLASS64) return -1;
+
+    if (header->e_phentsize == sizeof(Elf64_Phdr) &&
+        in_file(image, header->e_phoff, (uint64_t)header->e_phnum * sizeof(Elf64_Phdr))) {
+        const Elf64_Phdr *phdrs = (const Elf64_Phdr *)(base + header->e_phoff);
+        for (int i = 0; i < header->e_phnum && image->segment_count < MAX_LOAD_SEGMENTS; i++) {
+            if (phdrs[i].p_type != PT_LOAD) continue;
+            LoadSegment *segment = &image->segments[image->segment_count++];
+            segment->offset = phdrs[i].p_offset;
+            segment->vaddr = phdrs[i].p_vaddr;
+            segment->size = phdrs[i].p_filesz;
+        }
+    }
+
+    if (header->e_shentsize != sizeof(Elf64_Shdr) ||
+        !in_file(image, header->e_shoff, (uint64_t)header->e_shnum * sizeof(Elf64_Shdr))) return -1;
+    const Elf64_Shdr *sections = (const Elf64_Shdr *)(base + header->e_shoff);
+
+    const Elf64_Shdr *table = NULL;
+    for (int i = 0; i < header->e_shnum; i++) {
+        if (sections[i].sh_type == SHT_SYMTAB) table = &sections[i];
+        if (sections[i].sh_type == SHT_DYNSYM && !table) table = &sections[i];
+    }
+    if (!table || table->sh_link >= header->e_shnum || table->sh_entsize != sizeof(Elf64_Sym)) return -1;
+
+    const Elf64_Shdr *strings = &sections[table->sh_link];
+    if (!in_file(image, table->sh_offset, table->sh_size) ||
+        !in_file(image, strings->sh_offset, strings->sh_size)) return -1;
+
+    const Elf64_Sym *syms = (const Elf64_Sym *)(base + table->sh_offset);
+    const char *names = (const char *)(base + strings->sh_offset);
+    int total = (int)(table->sh_size / sizeof(Elf64_Sym));
+
+    image->symbols = malloc((total > 0 ? total : 1) * sizeof(FunctionSymbol));
+    if (!image->symbols) return -1;
+
+    for (int i = 0; i < total; i++) {
+        int type = ELF64_ST_TYPE(syms[i].st_info);
+        if ((type != STT_FUNC && type != STT_GNU_IFUNC) || syms[i].st_shndx == SHN_UNDEF ||
+            syms[i].st_value == 0 || syms[i].st_name >= strings->sh_size) continue;
+
+        FunctionSymbol *symbol = &image->symbols[image->count++];
+        symbol->start = syms[i].st_value;
+        symbol->size = syms[i].st_size;
+        symbol->name = names + syms[i].st_name;
+    }
+    qsort(image->symbols, image->count, sizeof(FunctionSymbol), compare_symbols);
+    return 0;
+}
+
+/* Returns: the cache index of the file behind a mapping, or -1 */
+static int load_image(int pid, const char *path, unsigned long long dev, unsigned long long inode) {
+    for (int i = 0; i < image_count; i++) {
+        if (images[i].dev == dev && images[i].inode == inode) return i;
+    }
+    if (image_count == SYMBOL_MAX_IMAGES || heap_frozen) return -1;
+
+    /* Through the process's root, so files in another mount namespace resolve */
+    char root_path[4200];
+    snprintf(root_path, sizeof(root_path), "/proc/%d/root%s", pid, path);
+    int fd = open(root_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(Elf64_Ehdr)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    SymbolImage *image = &images[image_count];
+    memset(image, 0, sizeof(*image));
+    image->dev = dev;
+    image->inode = inode;
+    image->map = map;
+    image->size = st.st_size;
+    if (index_symbols(image) < 0) {
+        free(image->symbols);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    return image_count++;
+}
+
+/* ========== Process Mappings ========== */
+
+static int read_mappings(ProcessSymbols *symbols) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/maps", symbols->pid);
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    symbols->count = 0;
+    symbols->reloaded_ns = monotonic_ns();
+    symbols->reloads++;
+
+    char line[4352];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long long start, end, offset, inode;
+        unsigned major, minor;
+        char perms[8];
+        int name_at = 0;
+        if (sscanf(line, "%llx-%llx %7s %llx %x:%x %llu %n", &start, &end, perms, &offset,
+                   &major, &minor, &inode, &name_at) < 7 || perms[2] != 'x') continue;
+
+        if (symbols->count == symbols->capacity) {
+            int new_capacity = symbols->capacity ? symbols->capacity * 2 : 64;
+            SymbolMapping *grown = realloc(symbols->mappings, new_capacity * sizeof(SymbolMapping));
+            if (!grown) break;
+            symbols->mappings = grown;
+            symbols->capacity = new_capacity;
+        }
+
+        char *name = line + name_at;
+        name[strcspn(name, "\n")] = '\0';
+
+        SymbolMapping *mapping = &symbols->mappings[symbols->count++];
+        mapping->start = start;
+        mapping->end = end;
+        mapping->offset = offset;
+        mapping->image = name[0] == '/' && inode ?
+                         load_image(symbols->pid, name, (unsigned long long)major << 32 | minor, inode) : -1;
+
+        const char *base = strrchr(name, '/');
+        snprintf(mapping->name, sizeof(mapping->name), "%s", base ? base + 1 : name[0] ? name : "[anon]");
+    }
+    fclose(file);
+    return 0;
+}
+
+int process_symbols_open(ProcessSymbols *symbols, int pid) {
+    memset(symbols, 0, sizeof(*symbols));
+    symbols->pid = pid;
+    if (heap_frozen) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return read_mappings(symbols);
+}
+
+void process_symbols_close(ProcessSymbols *symbols) {
+    free(symbols->mappings);
+    memset(symbols, 0, sizeof(*symbols));
+}
+
+static const SymbolMapping* find_mapping(const ProcessSymbols *symbols, uint64_t address) {
+    int low = 0;
+    int high = symbols->count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        const SymbolMapping *mapping = &symbols->mappings[mid];
+        if (address < mapping->start) {
+            high = mid - 1;
+        } else if (address >= mapping->end) {
+            low = mid + 1;
+        } else {
+            return mapping;
+        }
+    }
+    return NULL;
+}
+
+/* The symbol at or below a link-time address. Returns: NULL if none covers it */
+static const FunctionSymbol* find_symbol(const SymbolImage *image, uint64_t vaddr) {
+    int low = 0;
+    int high = image->count - 1;
+    const FunctionSymbol *best = NULL;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (image->symbols[mid].start <= vaddr) {
+            best = &image->symbols[mid];
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    /* Assembly routines often have no size; give them the address anyway */
+    if (best && best->size && vaddr >= best->start + best->size) return NULL;
+    return best;
+}
+
+int symbolize(ProcessSymbols *symbols, uint64_t address, Symbol *symbol) {
+    symbols->lookups++;
+
+    const SymbolMapping *mapping = find_mapping(symbols, address);
+    if (!mapping && monotonic_ns() - symbols->reloaded_ns >= RELOAD_INTERVAL_NS) {
+        read_mappings(symbols);
+        mapping = find_mapping(symbols, address);
+    }
+    if (!mapping) {
+        symbols->unmapped++;
+        symbol->function = NULL;
+        symbol->object = NULL;
+        symbol->offset = address;
+        return -1;
+    }
+
+    uint64_t file_offset = address - mapping->start + mapping->offset;
+    symbol->function = NULL;
+    symbol->object = mapping->name;
+    symbol->offset = file_offset;
+    if (mapping->image < 0) return 0;
+
+    /* File offset to link-time address through the segment holding it */
+    const SymbolImage *image = &images[mapping->image];
+    for (int i = 0; i < image->segment_count; i++) {
+        const LoadSegment *segment = &image->segments[i];
+        if (file_offset < segment->offset || file_offset >= segment->offset + segment->size) continue;
+
+        uint64_t vaddr = file_offset - segment->offset + segment->vaddr;
+        const FunctionSymbol *function = find_symbol(image, vaddr);
+        if (function) {
+            symbol->function = function->name;
+            symbol->offset = vaddr - function->start;
+        }
+        break;
+    }
+    return 0;
+}
+
+void symbol_cache_get_stats(SymbolCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->images = image_count;
+    for (int i = 0; i < image_count; i++) {
+        stats->functions += images[i].count;
+        stats->mapped_bytes += images[i].size;
+    }
+}
+
+void symbol_cache_free(void) {
+    for (int i = 0; i < image_count; i++) {
+        free(images[i].symbols);
+        munmap(images[i].map, images[i].size);
+    }
+    image_count = 0;
+}
+
+#else /* !__linux__ */
+
+/* No /proc and no ELF on other systems; profiling is refused before any lookup */
+
+int process_symbols_open(ProcessSymbols *symbols, int pid) {
+    memset(symbols, 0, sizeof(*symbols));
+    symbols->pid = pid;
+    errno = ENOSYS;
+    return -1;
+}
+
+void process_symbols_close(ProcessSymbols *symbols) {
+    memset(symbols, 0, sizeof(*symbols));
+}
+
+int symbolize(ProcessSymbols *symbols, uint64_t address, Symbol *symbol) {
+    (void)symbols;
+    symbol->function = NULL;
+    symbol->object = NULL;
+    symbol->offset = address;
+    return -1;
+}
+
+void symbol_cache_get_stats(SymbolCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void symbol_cache_free(void) {
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,64 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ========== ELF Symbol Index ========== */
+
+/*
+ * Turns instruction addresses sampled in a process into function names.
+ * Each ELF file is parsed once and its function symbols kept sorted by
+ * address; the index is shared by every process that maps the file (keyed
+ * by device and inode), so profiling another process reuses libc and the
+ * like. A process's mappings are re-read only when an address falls outside
+ * all of them, e.g. after a dlopen().
+ */
+
+#define SYMBOL_MAX_IMAGES 256   /* ELF files indexed at once */
+
+typedef struct {
+    const char *function;   /* NULL if no symbol covers the address */
+    const char *object;     /* File basename or mapping name, e.g. "[vdso]"; NULL if unmapped */
+    uint64_t offset;        /* Into the function, or into the object without one */
+} Symbol;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;        /* File offset of start */
+    int image;              /* Index into the image cache, -1 if not an ELF file we could read */
+    char name[64];          /* Basename or pseudo-name, e.g. "[vdso]" */
+} SymbolMapping;
+
+typedef struct {
+    int pid;
+    SymbolMapping *mappings;   /* Executable mappings, sorted by address */
+    int count;
+    int capacity;
+    uint64_t reloaded_ns;      /* Last read of /proc/[pid]/maps */
+
+    unsigned long lookups;
+    unsigned long unmapped;    /* Addresses outside every mapping, even after a reload */
+    unsigned long reloads;
+} ProcessSymbols;
+
+typedef struct {
+    int images;             /* ELF files indexed */
+    long functions;         /* Function symbols across them */
+    size_t mapped_bytes;    /* Files kept mapped for their string tables */
+} SymbolCacheStats;
+
+/* Read the executable mappings of a process. Returns: -1 with errno set */
+int process_symbols_open(ProcessSymbols *symbols, int pid);
+void process_symbols_close(ProcessSymbols *symbols);
+
+/* Returns: 0 with symbol filled in, -1 if the address is not mapped */
+int symbolize(ProcessSymbols *symbols, uint64_t address, Symbol *symbol);
+
+void symbol_cache_get_stats(SymbolCacheStats *stats);
+
+/* Drop every indexed file */
+void symbol_cache_free(void);
+
+#endif /* SYMBOLS_H */
@@ -1,19 +1,819 @@
 #include "task_data.h"
+#include "snapshot.h"
+#include "cmdline_cache.h"
+#include "user_cache.h"
+#include "survival.h"
+#include "timing.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
 
-/* ========== Task Data Collection ========== */
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define PF_KTHREAD 0x00200000  /* Task flag of kernel threads, include/linux/sched.h */
+
+InternTable command_names;
+InternTable wait_channels;
+
+static CmdlineCache cmdline_cache;
+static CollectStats collect_stats;
+
+int is_numeric(char* str) {
+    if (*str == '\0') return 0;
+    while (*str != '\0') {
+        int is_digit_result = isdigit((unsigned char)*str);
+        if (!is_digit_result) {
+	    return 0;
+	}
+  	str++;
+    }
+    return 1;
+}
+
+/* The same task in the previous snapshot. Returns: NULL if it is new */
+static const TaskInfo* previous_sample(const Snapshot *prev, const TaskInfo *task) {
+    if (!prev) return NULL;
+    int row = snapshot_find_tid(prev, task->tid);
+    if (row < 0) return NULL;
+
+    /* A reused tid is a different task; it has no history yet */
+    const TaskInfo *old = &prev->tasks[row];
+    return old->starttime == task->starttime ? old : NULL;
+}
+
+#ifdef __linux__
+
+/* ========== Sampling Schedule ========== */
+
+static uint32_t collect_tick;  /* Advances once per collection */
+static uint64_t tick_ns;        /* Nominal tick of the running collection */
+
+/* Turn-taking among tasks outside the priority set */
+static struct {
+    int start;    /* Ordinal this tick resumes from */
+    int index;    /* Ordinal of the next background task seen */
+    int resume;   /* Where the next tick starts; -1 until the budget runs out */
+    int budget;   /* File reads left this tick */
+} round_robin;
+
+/*
+ * Hashed timing wheel: a task's slot in a period of N ticks is derived from
+ * its id, and a tiered source is read when the tick reaches that slot. Tasks
+ * spread evenly over the period without keeping any per-task schedule.
+ */
+static int slot_due(int id, int period) {
+    if (period <= 1) return 1;
+    return ((uint32_t)id * 2654435761u + collect_tick) % (uint32_t)period == 0;
+}
+
+/* Read a planned source now, or carry it over? A task that was never sampled
+ * is read straight away, then settles into its slot. One that missed its slot
+ * while waiting for a round-robin turn is read once a period has passed.
+ */
+static int source_due(int id, const TaskInfo *old, ProcSource source,
+                      const CollectPlan *plan, uint64_t now) {
+    if (!old || !old->sampled_ns[source]) return 1;
+    int period = plan->periods[source];
+    return slot_due(id, period) || now - old->sampled_ns[source] >= period * tick_ns;
+}
+
+/* Is it this background task's turn? Turns run in /proc order from where the
+ * previous tick's budget ran out, and wrap round once the end is reached
+ */
+static int round_robin_turn(void) {
+    int index = round_robin.index++;
+    if (index < round_robin.start) return 0;
+    if (round_robin.budget > 0) return 1;
+    if (round_robin.resume < 0) round_robin.resume = index;
+    return 0;
+}
+
+/* Is this background task in the tick's sample? Every tick draws a new
+ * subset, each task independently with probability fraction
+ */
+static int in_sample(int tid, double fraction) {
+    uint64_t x = (uint64_t)(uint32_t)tid << 32 | collect_tick;
+
+    /* splitmix64 finaliser */
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (x >> 11) * (1.0 / 9007199254740992.0) < fraction;
+}
+
+static int file_reads(void) {
+    return collect_stats.reads[SOURCE_STAT] + collect_stats.reads[SOURCE_STATM] +
+           collect_stats.reads[SOURCE_IO] + collect_stats.reads[SOURCE_CMDLINE] +
+           collect_stats.reads[SOURCE_WCHAN] + collect_stats.reads[SOURCE_FD];
+}
+
+/* Copy one source's values, and when they were read, from the previous sample */
+static void carry_source(TaskInfo *task, const TaskInfo *old, ProcSource source) {
+    switch (source) {
+        case SOURCE_STATM:
+            task->vm_size = old->vm_size;
+            task->rss = old->rss;
+            break;
+        case SOURCE_IO:
+            task->io_read_bytes = old->io_read_bytes;
+            task->io_write_bytes = old->io_write_bytes;
+            task->io_read_rate = old->io_read_rate;
+            task->io_write_rate = old->io_write_rate;
+            break;
+        case SOURCE_FD:
+            task->fd_count = old->fd_count;
+            task->fd_limit = old->fd_limit;
+            task->fd_rate = old->fd_rate;
+            break;
+        default:
+            break;
+    }
+    task->collected |= old->collected & source_fields(source);
+    task->sampled_ns[source] = old->sampled_ns[source];
+    collect_stats.carried[source]++;
+}
+
+/* ========== Directory Listing ========== */
+
+/*
+ * /proc directories are listed with getdents64 into a fixed buffer. Unlike
+ * opendir(), this allocates nothing, which survival mode relies on.
+ */
+typedef struct {
+    int fd;
+    int len;
+    int pos;
+    uint64_t ino;        /* Inode number of the entry dir_next() returned last */
+    uint64_t buf[1024];  /* 8KB, aligned for the records */
+} DirStream;
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static int dir_open(DirStream *dir, const char *path) {
+    dir->fd = open(path, O_RDONLY | O_DIRECTORY);
+    dir->len = 0;
+    dir->pos = 0;
+    return dir->fd < 0 ? -1 : 0;
+}
+
+/* Returns: the next entry's name, or NULL at the end */
+static char* dir_next(DirStream *dir) {
+    if (dir->pos >= dir->len) {
+        long len = syscall(SYS_getdents64, dir->fd, dir->buf, sizeof(dir->buf));
+        if (len <= 0) return NULL;
+        dir->len = (int)len;
+        dir->pos = 0;
+    }
+
+    struct linux_dirent64 *entry = (struct linux_dirent64*)((char*)dir->buf + dir->pos);
+    dir->pos += entry->d_reclen;
+    dir->ino = entry->d_ino;
+    return entry->d_name;
+}
+
+static void dir_close(DirStream *dir) {
+    close(dir->fd);
+}
+
+/* ========== /proc Parsing ========== */
+
+/*
+ * Read a small /proc file into buf as a NUL-terminated string
+ * Returns: number of bytes read, or -1 if the file could not be read
+ */
+static int read_proc_file(const char *path, char *buf, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+    if (len < 0) return -1;
+
+    buf[len] = '\0';
+    return (int)len;
+}
+
+/* Skip ahead by count space-separated fields. Returns: NULL if the line ends first */
+static char* skip_fields(char *p, int count) {
+    while (count-- > 0) {
+        p = strchr(p, ' ');
+        if (!p) return NULL;
+        p++;
+    }
+    return p;
+}
+
+/*
+ * Parse /proc/[pid]/task/[tid]/stat. The command is enclosed in parentheses
+ * and may itself contain spaces or ')', so fields are counted from the last ')'
+ * Returns: 0 on success, -1 on malformed input
+ */
+static int parse_stat(char *buf, TaskInfo *task) {
+    char *open_paren = strchr(buf, '(');
+    char *close_paren = strrchr(buf, ')');
+    if (!open_paren || !close_paren || close_paren < open_paren) return -1;
+
+    size_t comm_len = close_paren - open_paren - 1;
+    if (comm_len >= sizeof(task->command)) comm_len = sizeof(task->command) - 1;
+    memcpy(task->command, open_paren + 1, comm_len);
+    task->command[comm_len] = '\0';
+
+    /* Field 3 (state) follows ") " */
+    char *p = close_paren + 2;
+    task->state = *p;
+
+    /* Field 9: flags */
+    p = skip_fields(p, 9 - 3);
+    if (!p) return -1;
+    unsigned long flags = strtoul(p, &p, 10);
+    task->kernel_thread = (flags & PF_KTHREAD) != 0;
+
+    /* Fields 14-15: utime, stime */
+    p = skip_fields(p, 14 - 9);
+    if (!p) return -1;
+    unsigned long long utime = strtoull(p, &p, 10);
+    unsigned long long stime = strtoull(p, &p, 10);
+    task->cpu_ticks = utime + stime;
+
+    /* Field 22: starttime */
+    p = skip_fields(p + 1, 22 - 16);
+    if (!p) return -1;
+    task->starttime = strtoull(p, NULL, 10);
+    return 0;
+}
+
+/*
+ * schedstat starts with the task's on-CPU time in nanoseconds, where stat's
+ * utime + stime count whole clock ticks: at 100 Hz a one-second sample of a
+ * task using 3.5 ms reads as 0% or 1%. Kernels built without schedstats
+ * lack the file; that is checked once.
+ */
+static void read_schedstat(const char *task_path, TaskInfo *task) {
+    static int available = -1;
+    char path[96];
+    char buf[128];
+
+    if (available < 0) available = access("/proc/self/schedstat", R_OK) == 0;
+    if (!available) return;
+
+    snprintf(path, sizeof(path), "%s/schedstat", task_path);
+    collect_stats.schedstat_reads++;
+    if (read_proc_file(path, buf, sizeof(buf)) <= 0) return;
+    task->cpu_ns_sampled = monotonic_ns();
+    task->cpu_ns = strtoull(buf, NULL, 10);
+}
+
+/* statm reports sizes in pages */
+static void read_statm(const char *task_path, TaskInfo *task) {
+    static long page_size = 0;
+    char path[96];
+    char buf[256];
+
+    if (!page_size) page_size = sysconf(_SC_PAGESIZE);
+
+    snprintf(path, sizeof(path), "%s/statm", task_path);
+    collect_stats.reads[SOURCE_STATM]++;
+    int len = read_proc_file(path, buf, sizeof(buf));
+    task->sampled_ns[SOURCE_STATM] = monotonic_ns();
+    if (len <= 0) {
+        collect_stats.failed[SOURCE_STATM]++;
+        return;
+    }
+
+    unsigned long long size = 0, resident = 0;
+    if (sscanf(buf, "%llu %llu", &size, &resident) != 2) return;
+    task->vm_size = size * page_size;
+    task->rss = resident * page_size;
+    task->collected |= FIELD_BIT(FIELD_MEMORY);
+}
+
+/* The symbol a thread sleeps in, interned: the same few dozen names come up
+ * tick after tick. "0" means it is not sleeping and is left uncollected */
+static void read_wchan(const char *task_path, TaskInfo *task) {
+    char path[96];
+    char buf[128];
+
+    snprintf(path, sizeof(path), "%s/wchan", task_path);
+    collect_stats.reads[SOURCE_WCHAN]++;
+    int len = read_proc_file(path, buf, sizeof(buf));
+    task->sampled_ns[SOURCE_WCHAN] = monotonic_ns();
+    if (len <= 0) {
+        collect_stats.failed[SOURCE_WCHAN]++;
+        return;
+    }
+    if (strcmp(buf, "0") == 0) return;
+
+    task->wchan_id = intern_string(&wait_channels, buf);
+    if (task->wchan_id >= 0) task->collected |= FIELD_BIT(FIELD_WCHAN);
+}
+
+/* io is only readable for our own processes unless we run as root */
+static void read_io(const char *task_path, TaskInfo *task) {
+    char path[96];
+    char buf[512];
+
+    snprintf(path, sizeof(path), "%s/io", task_path);
+    collect_stats.reads[SOURCE_IO]++;
+    int len = read_proc_file(path, buf, sizeof(buf));
+    task->sampled_ns[SOURCE_IO] = monotonic_ns();
+    if (len <= 0) {
+        collect_stats.failed[SOURCE_IO]++;
+        return;
+    }
+
+    char *read_bytes = strstr(buf, "\nread_bytes: ");
+    char *write_bytes = strstr(buf, "\nwrite_bytes: ");
+    if (!read_bytes || !write_bytes) return;
+    task->io_read_bytes = strtoull(read_bytes + 13, NULL, 10);
+    task->io_write_bytes = strtoull(write_bytes + 14, NULL, 10);
+    task->collected |= FIELD_BIT(FIELD_IO_BYTES);
+}
+
+/*
+ * Descriptors open in a process. Since Linux 6.2 the size of the fd
+ * directory is the count, one stat() instead of a listing; older kernels
+ * report 0, and the first empty answer for a process that does have
+ * descriptors switches to counting entries for good.
+ * Returns: the count, or -1 if the directory cannot be read
+ */
+static int count_fds(const char *path) {
+    static int size_counts = -1;  /* Does st_size count? -1 = not known yet */
+    static DirStream fd_dir;
+
+    if (size_counts != 0) {
+        struct stat st;
+        if (stat(path, &st) < 0) return -1;
+        if (st.st_size > 0) {
+            size_counts = 1;
+            return (int)st.st_size;
+        }
+        if (size_counts == 1) return 0;
+    }
+
+    if (dir_open(&fd_dir, path) < 0) return -1;
+    int count = 0;
+    char *name;
+    while ((name = dir_next(&fd_dir)) != NULL) {
+        if (name[0] != '.') count++;
+    }
+    dir_close(&fd_dir);
+    if (count > 0) size_counts = 0;
+    return count;
+}
+
+/* "Max open files            1024                 524288               files" */
+static int read_fd_limit(int pid) {
+    char path[64];
+    char buf[4096];
+    snprintf(path, sizeof(path), "/proc/%d/limits", pid);
+
+    collect_stats.reads[SOURCE_FD]++;
+    if (read_proc_file(path, buf, sizeof(buf)) <= 0) return 0;
+
+    char *line = strstr(buf, "Max open files");
+    if (!line) return 0;
+    line += strlen("Max open files");
+    while (*line == ' ') line++;
+    return isdigit((unsigned char)*line) ? atoi(line) : 0;  /* "unlimited" */
+}
+
+/* Open descriptors of the process and their soft limit */
+static void read_fds(int pid, TaskInfo *task) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+
+    collect_stats.reads[SOURCE_FD]++;
+    int count = count_fds(path);
+    task->sampled_ns[SOURCE_FD] = monotonic_ns();
+    if (count < 0) {
+        collect_stats.failed[SOURCE_FD]++;  /* Another user's process, or gone */
+        return;
+    }
+    task->fd_count = count;
+    task->fd_limit = read_fd_limit(pid);
+    task->collected |= FIELD_BIT(FIELD_FDS);
+}
+
+/* /proc/[pid]/cmdline separates arguments with NULs; join them with spaces */
+static void read_cmdline(int pid, char *buf, size_t size) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+
+    collect_stats.reads[SOURCE_CMDLINE]++;
+    int len = read_proc_file(path, buf, size);
+    if (len <= 0) {
+        buf[0] = '\0';  /* Kernel thread, zombie, or already gone */
+        return;
+    }
+
+    while (len > 0 && buf[len - 1] == '\0') len--;
+    for (int i = 0; i < len; i++) {
+        if (buf[i] == '\0' || buf[i] == '\n') buf[i] = ' ';
+    }
+    buf[len] = '\0';
+}
+
+/*
+ * Command line for a process, from the cache or read once on first sight.
+ * The snapshot gets its own copy so it outlives cache eviction.
+ */
+static const char* process_cmdline(Snapshot *snapshot, const TaskInfo *leader) {
+    char buf[4096];
+    int pid = leader->pid;
+    const char *cmdline = cmdline_cache_get(&cmdline_cache, pid, leader->starttime,
+                                            leader->command_id);
+
+    if (!cmdline) {
+        read_cmdline(pid, buf, sizeof(buf));
+        if (buf[0] == '\0') {
+            /* No command line: show the command in brackets, like ps does */
+            snprintf(buf, sizeof(buf), "[%s]", leader->command);
+        }
+        cmdline = cmdline_cache_put(&cmdline_cache, pid, leader->starttime,
+                                    leader->command_id, buf);
+        if (!cmdline) cmdline = buf;
+    }
+
+    return arena_strndup(&snapshot->arena, cmdline, sizeof(buf));
+}
+
+/*
+ * The thread-group leader, which names the process in the command line cache.
+ * It is listed first, so it is at first_row once read this tick; a leader
+ * waiting for its turn, or gone, is looked for in the previous snapshot.
+ * Returns: NULL if neither has it
+ */
+static const TaskInfo* process_leader(const Snapshot *snapshot, const Snapshot *prev,
+                                      int pid, int first_row) {
+    if (first_row < snapshot->count && snapshot->tasks[first_row].tid == pid) {
+        return &snapshot->tasks[first_row];
+    }
+    int row = prev ? snapshot_find_tid(prev, pid) : -1;
+    return row >= 0 && !prev->tasks[row].exited ? &prev->tasks[row] : NULL;
+}
+
+/*
+ * The leader's command line for this snapshot: carried over from the previous
+ * one between its slots, unless the process exec()ed since. With the heap
+ * frozen the cache takes no new lines, so a due slot would read the file
+ * again every period; the line is carried then too.
+ */
+static const char* leader_cmdline(Snapshot *snapshot, const Snapshot *prev, const TaskInfo *leader,
+                                  const CollectPlan *plan, uint64_t *sampled_ns) {
+    const TaskInfo *old = previous_sample(prev, leader);
+    int due = source_due(leader->pid, old, SOURCE_CMDLINE, plan, snapshot->taken_ns) &&
+              !(heap_frozen && old);
+    if (due || old->command_id != leader->command_id || !(old->collected & FIELD_BIT(FIELD_CMDLINE))) {
+        *sampled_ns = snapshot->taken_ns;
+        return process_cmdline(snapshot, leader);
+    }
+    collect_stats.carried[SOURCE_CMDLINE]++;
+    *sampled_ns = old->sampled_ns[SOURCE_CMDLINE];
+    return arena_strndup(&snapshot->arena, old->cmdline, 4096);
+}
+
+/*
+ * Kernel threads have no user memory, no I/O of their own and no command
+ * line, so their secondary files are never opened: the values are known.
+ * Returns: the file reads this saved
+ */
+static int fill_kernel_thread(Snapshot *snapshot, TaskInfo *task, const TaskInfo *old,
+                              const CollectPlan *plan) {
+    uint64_t now = snapshot->taken_ns;
+    int saved = 0;
+
+    if (plan->sources & SOURCE_BIT(SOURCE_STATM)) {
+        saved += source_due(task->tid, old, SOURCE_STATM, plan, now);
+        task->collected |= FIELD_BIT(FIELD_MEMORY);
+        task->sampled_ns[SOURCE_STATM] = now;
+    }
+    if (plan->sources & SOURCE_BIT(SOURCE_IO)) {
+        saved += source_due(task->tid, old, SOURCE_IO, plan, now);
+        task->collected |= FIELD_BIT(FIELD_IO_BYTES);
+        task->sampled_ns[SOURCE_IO] = now;
+    }
+    if (plan->sources & SOURCE_BIT(SOURCE_CMDLINE)) {
+        /* Shown in brackets, like ps does; the cache would only read it once */
+        char buf[sizeof(task->command) + 2];
+        snprintf(buf, sizeof(buf), "[%s]", task->command);
+        const char *cmdline = arena_strndup(&snapshot->arena, buf, sizeof(buf));
+        if (cmdline) {
+            saved += !old;
+            task->cmdline = cmdline;
+            task->collected |= FIELD_BIT(FIELD_CMDLINE);
+            task->sampled_ns[SOURCE_CMDLINE] = now;
+        }
+    }
+    if (plan->sources & SOURCE_BIT(SOURCE_FD)) {
+        saved += task->tid == task->pid && source_due(task->pid, old, SOURCE_FD, plan, now);
+        task->collected |= FIELD_BIT(FIELD_FDS);
+        task->sampled_ns[SOURCE_FD] = now;
+    }
+    return saved;
+}
+
+/*
+ * Collect every thread of one process. Threads waiting for their round-robin
+ * turn are copied whole from the previous snapshot without reading anything.
+ * Returns: -1 if the snapshot ran out of memory
+ */
+static int collect_process(Snapshot *snapshot, const Snapshot *prev, int pid,
+                           const CollectPlan *plan, const CollectSchedule *schedule) {
+    char path[96];
+    char task_path[64];
+    char buf[1024];
+    const char *cmdline = NULL;
+    uint64_t cmdline_ns = 0;
+    int first_row = snapshot->count;
+    int fds_row = -1;  /* The leader's row, when it read the descriptors this tick */
+    int have_uid = 0;
+    struct stat owner;
+
+    DirStream task_dir;
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    if (dir_open(&task_dir, path) < 0) return 0;  /* Process exited */
+
+    char *name;
+    while ((name = dir_next(&task_dir)) != NULL) {
+        if (!is_numeric(name)) continue;
+
+        /* procfs gives each task's entry a fresh inode, so a tid that was
+         * reused since the last tick shows up without reading anything; an
+         * entry the kernel evicted and rebuilt only costs a read */
+        int tid = atoi(name);
+        int row = prev ? snapshot_find_tid(prev, tid) : -1;
+        if (row >= 0 && (prev->tasks[row].exited || prev->tasks[row].pid != pid ||
+                         prev->tasks[row].proc_ino != task_dir.ino)) {
+            row = -1;
+        }
+        int priority = row < 0 || intmap_get(schedule->priority, tid) >= 0;
+        int turn = priority ||
+                   (schedule->sample_fraction < 1.0 ? in_sample(tid, schedule->sample_fraction) :
+                                                      round_robin_turn());
+        if (!turn) {
+            TaskInfo *task = snapshot_add_task(snapshot);
+            if (!task) {
+                dir_close(&task_dir);
+                return -1;
+            }
+            *task = prev->tasks[row];
+            if (!cmdline && task->cmdline[0] != '\0') {
+                cmdline = arena_strndup(&snapshot->arena, task->cmdline, 4096);
+                cmdline_ns = task->sampled_ns[SOURCE_CMDLINE];
+            }
+            task->cmdline = cmdline ? cmdline : "";
+            collect_stats.deferred++;
+            continue;
+        }
+        uint64_t proc_ino = task_dir.ino;
+        int reads_before = file_reads();
+
+        snprintf(task_path, sizeof(task_path), "/proc/%d/task/%d", pid, tid);
+        snprintf(path, sizeof(path), "%s/stat", task_path);
+        collect_stats.reads[SOURCE_STAT]++;
+        if (read_proc_file(path, buf, sizeof(buf)) <= 0) {
+            collect_stats.failed[SOURCE_STAT]++;
+            continue;
+        }
+        uint64_t stat_ns = monotonic_ns();
+
+        TaskInfo *task = snapshot_add_task(snapshot);
+        if (!task) {
+            dir_close(&task_dir);
+            return -1;
+        }
+
+        memset(task, 0, sizeof(*task));
+        task->pid = pid;
+        task->tid = tid;
+        task->proc_ino = proc_ino;
+        task->cmdline = "";
+        if (parse_stat(buf, task) < 0) {
+            snapshot->count--;
+            continue;
+        }
+        task->command_id = intern_string(&command_names, task->command);
+        if (task->command_id < 0) {
+            snapshot->count--;
+            dir_close(&task_dir);
+            return -1;
+        }
+        task->collected = FIELD_BIT(FIELD_IDENTITY) | FIELD_BIT(FIELD_COMMAND) |
+                          FIELD_BIT(FIELD_STATE) | FIELD_BIT(FIELD_CPU_TIME);
+        task->sampled_ns[SOURCE_STAT] = stat_ns;
+
+        const TaskInfo *old = previous_sample(prev, task);
+
+        /* Rows on screen get nanosecond CPU time; the rest make do with ticks */
+        if (priority && (plan->fields & FIELD_BIT(FIELD_CPU_TIME))) read_schedstat(task_path, task);
+
+        /* /proc/[pid]/task is owned by the process's effective uid; one
+         * fstat() per process, and no file to open or parse. Kernel threads
+         * are root's */
+        if ((plan->fields & FIELD_BIT(FIELD_UID)) && task->kernel_thread) {
+            task->uid = 0;
+            task->collected |= FIELD_BIT(FIELD_UID);
+        } else if (plan->fields & FIELD_BIT(FIELD_UID)) {
+            if (!have_uid) have_uid = fstat(task_dir.fd, &owner) == 0;
+            if (have_uid) {
+                task->uid = owner.st_uid;
+                task->collected |= FIELD_BIT(FIELD_UID);
+                user_name_id(task->uid);  /* A new uid goes to the resolver now */
+            }
+        }
+
+        if (task->kernel_thread) {
+            collect_stats.kernel_threads++;
+            collect_stats.kernel_reads_saved += fill_kernel_thread(snapshot, task, old, plan);
+        } else {
+            if (plan->sources & SOURCE_BIT(SOURCE_STATM)) {
+                if (source_due(tid, old, SOURCE_STATM, plan, snapshot->taken_ns)) {
+                    read_statm(task_path, task);
+                } else {
+                    carry_source(task, old, SOURCE_STATM);
+                }
+            }
+            if (plan->sources & SOURCE_BIT(SOURCE_IO)) {
+                if (source_due(tid, old, SOURCE_IO, plan, snapshot->taken_ns)) {
+                    read_io(task_path, task);
+                } else {
+                    carry_source(task, old, SOURCE_IO);
+                }
+            }
+
+            /* Threads share the process's command line; the leader is listed first */
+            if (plan->sources & SOURCE_BIT(SOURCE_CMDLINE)) {
+                if (!cmdline) {
+                    const TaskInfo *leader = process_leader(snapshot, prev, pid, first_row);
+                    cmdline = leader_cmdline(snapshot, prev, leader ? leader : task, plan, &cmdline_ns);
+                }
+                if (cmdline) {
+                    task->cmdline = cmdline;
+                    task->collected |= FIELD_BIT(FIELD_CMDLINE);
+                    task->sampled_ns[SOURCE_CMDLINE] = cmdline_ns;
+                }
+            }
+
+            /* So are the descriptors; the leader reads them for all */
+            if (plan->sources & SOURCE_BIT(SOURCE_FD)) {
+                if (fds_row >= 0) {
+                    const TaskInfo *fds = &snapshot->tasks[fds_row];
+                    task->fd_count = fds->fd_count;
+                    task->fd_limit = fds->fd_limit;
+                    task->fd_rate = fds->fd_rate;
+                    task->collected |= fds->collected & FIELD_BIT(FIELD_FDS);
+                    task->sampled_ns[SOURCE_FD] = fds->sampled_ns[SOURCE_FD];
+                } else if (tid == pid && source_due(pid, old, SOURCE_FD, plan, snapshot->taken_ns)) {
+                    read_fds(pid, task);
+                    fds_row = snapshot->count - 1;
+                } else if (old) {
+                    carry_source(task, old, SOURCE_FD);
+                }
+            }
+        }
+
+        /* Only blocked threads, and those the wait view watches, say what they wait on */
+        if ((plan->sources & SOURCE_BIT(SOURCE_WCHAN)) &&
+            (task->state == 'D' || intmap_get(schedule->wait_watch, tid) >= 0)) {
+            read_wchan(task_path, task);
+        }
+
+        if (priority) {
+            collect_stats.priority++;
+        } else {
+            collect_stats.background++;
+            round_robin.budget -= file_reads() - reads_before;
+        }
+    }
+    dir_close(&task_dir);
+
+    /* Listed this tick, read or not: its cached line outlives the sweep */
+    if ((plan->sources & SOURCE_BIT(SOURCE_CMDLINE)) && first_row < snapshot->count &&
+        snapshot->tasks[first_row].tid == pid) {
+        cmdline_cache_touch(&cmdline_cache, pid, snapshot->tasks[first_row].starttime);
+    }
+    return 0;
+}
+
+/*
+ * Walk /proc/[pid]/task/[tid] for every process and read each thread's stat,
+ * plus whichever other files the plan asks for and are due this tick. Command
+ * lines come from the (pid, starttime) cache; processes the walk no longer
+ * lists have exited and are evicted from it afterwards.
+ */
+int collect_task_data(Snapshot *snapshot, const Snapshot *prev, const CollectPlan *plan,
+                      const CollectSchedule *schedule) {
+    memset(&collect_stats, 0, sizeof(collect_stats));
+    collect_tick++;
+    user_cache_poll();
+    tick_ns = schedule->tick_ns;
+
+    round_robin.index = 0;
+    round_robin.resume = -1;
+    round_robin.budget = schedule->read_budget > 0 ? schedule->read_budget : INT_MAX;
+
+    static DirStream proc_dir;
+    if (dir_open(&proc_dir, "/proc") < 0) return -1;
+
+    char *name;
+    while ((name = dir_next(&proc_dir)) != NULL) {
+        if (!is_numeric(name)) continue;
+
+        if (collect_process(snapshot, prev, atoi(name), plan, schedule) < 0) {
+            /* In survival mode the snapshot is full rather than out of
+             * memory: show the tasks that fit instead of nothing */
+            if (!heap_frozen) {
+                dir_close(&proc_dir);
+                return -1;
+            }
+            collect_stats.truncated = 1;
+            break;
+        }
+    }
+    dir_close(&proc_dir);
+
+    /* Budget left over after the last task starts the next round from the top */
+    round_robin.start = round_robin.resume >= 0 ? round_robin.resume : 0;
+
+    /* Without command lines in the plan nothing was touched; keep the cache
+     * intact so showing the column again does not re-read every process. A
+     * truncated walk did not list every live process */
+    if ((plan->sources & SOURCE_BIT(SOURCE_CMDLINE)) && !collect_stats.truncated) {
+        cmdline_cache_sweep(&cmdline_cache, 1);
+    }
+    intern_update_ranks(&command_names);
+    intern_update_ranks(&user_names);
+    intern_update_ranks(&wait_channels);
+
+    return snapshot->count;
+}
+
+int read_kernel_stack(int pid, int tid, char *buf, size_t size) {
+    char path[64];
+    char raw[4096];
+
+    buf[0] = '\0';
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/stack", pid, tid);
+    if (read_proc_file(path, raw, sizeof(raw)) < 0) return -1;
+
+    /* Each line is "[<0>] symbol+0x46/0x70"; keep the symbols */
+    size_t used = 0;
+    char *line = raw;
+    while (*line) {
+        char *end = strchr(line, '\n');
+        if (end) *end = '\0';
+
+        char *name = strchr(line, ']');
+        name = name ? name + 1 : line;
+        while (*name == ' ') name++;
+        int len = (int)strcspn(name, "+");
+        if (len > 0) {
+            int written = snprintf(buf + used, size - used, "%s%.*s", used ? " < " : "", len, name);
+            if (written < 0 || (size_t)written >= size - used) break;
+            used += written;
+        }
+
+        if (!end) break;
+        line = end + 1;
+    }
+    return 0;
+}
+
+#else /* !__linux__ */
+
+int read_kernel_stack(int pid, int tid, char *buf, size_t size) {
+    (void)pid;
+    (void)tid;
+    if (size > 0) buf[0] = '\0';
+    errno = ENOSYS;
+    return -1;
+}
 
 /*
- * TODO: Replace this mock implementation with actual /proc parsing
- *
- * To implement real data collection:
- * 1. Iterate through /proc/[pid]/task/[tid] directories
- * 2. Read /proc/[pid]/task/[tid]/stat or /proc/[pid]/task/[tid]/status
- * 3. Parse the data to extract PID, TID, command name, and state
- * 4. Populate the TaskInfo structs
+ * There is no /proc here, so generate mock tasks instead
+ * TODO: Collect real data through libproc / sysctl
  */
-int collect_task_data(TaskInfo *tasks, int max_tasks) {
+int collect_task_data(Snapshot *snapshot, const Snapshot *prev, const CollectPlan *plan,
+                      const CollectSchedule *schedule) {
+    (void)prev;
+    (void)schedule;
     const char *mock_commands[] = {
         "systemd", "kthreadd", "bash", "vim", "firefox",
         "chrome", "docker", "nginx", "postgres", "python3",
@@ -22,24 +822,180 @@ int collect_task_data(TaskInfo *tasks, int max_tasks) {
     };
     const char states[] = {'R', 'S', 'S', 'S', 'D', 'S', 'S', 'S', 'S', 'S'};
     int num_commands = sizeof(mock_commands) / sizeof(mock_commands[0]);
-    int count = 0;
 
     /* Generate mock tasks */
-    for (int i = 0; i < 50 && count < max_tasks; i++) {
+    for (int i = 0; i < 50; i++) {
         int pid = 100 + i * 10;
         int num_threads = 1 + (i % 4);  /* 1-4 threads per process */
 
-        for (int t = 0; t < num_threads && count < max_tasks; t++) {
-            tasks[count].pid = pid;
-            tasks[count].tid = pid + t;
-            snprintf(tasks[count].command, sizeof(tasks[count].command),
+        for (int t = 0; t < num_threads; t++) {
+            int index = snapshot->count;
+            TaskInfo *task = snapshot_add_task(snapshot);
+            if (!task) return -1;
+
+            memset(task, 0, sizeof(*task));
+            task->pid = pid;
+            task->tid = pid + t;
+            task->uid = getuid();
+            snprintf(task->command, sizeof(task->command),
                     "%s", mock_commands[i % num_commands]);
-            tasks[count].state = states[count % 10];
-            count++;
+            task->state = states[index % 10];
+            task->command_id = intern_string(&command_names, task->command);
+            task->cmdline = arena_strndup(&snapshot->arena, task->command, sizeof(task->command));
+            task->collected = plan->fields;
+            for (int source = 0; source < SOURCE_COUNT; source++) {
+                task->sampled_ns[source] = snapshot->taken_ns;
+            }
         }
     }
 
-    return count;
+    intern_update_ranks(&command_names);
+    intern_update_ranks(&wait_channels);
+    user_name_id(getuid());
+    intern_update_ranks(&user_names);
+
+    return snapshot->count;
+}
+
+#endif /* __linux__ */
+
+/* ========== Rates ========== */
+
+int state_bucket(char state) {
+    switch (state) {
+        case 'R':           return STATE_RUNNING;
+        case 'S': case 'I': return STATE_SLEEPING;
+        case 'D':           return STATE_DISK;
+        case 'Z': case 'X': return STATE_ZOMBIE;
+        case 'T': case 't': return STATE_STOPPED;
+        default:            return -1;
+    }
+}
+
+/*
+ * Decay the shares by the interval between two stat reads and give the
+ * interval to the states seen at its ends, half each: a task seen in D and
+ * then in S was in D for about half of the time in between.
+ */
+static void account_state_time(TaskInfo *task, const TaskInfo *old, uint64_t interval_ns) {
+    float keep = (float)exp(-(double)interval_ns / STATE_WINDOW_NS);
+    float added = 1.0f - keep;
+
+    for (int s = 0; s < STATE_COUNT; s++) task->state_share[s] = old->state_share[s] * keep;
+    task->state_weight = old->state_weight * keep;
+
+    int from = state_bucket(old->state);
+    int to = state_bucket(task->state);
+    if (from >= 0) {
+        task->state_share[from] += added / 2;
+        task->state_weight += added / 2;
+    }
+    if (to >= 0) {
+        task->state_share[to] += added / 2;
+        task->state_weight += added / 2;
+    }
+    task->state_changes = old->state_changes + (old->state != task->state);
+}
+
+void state_totals(const Snapshot *snapshot, double totals[STATE_COUNT]) {
+    for (int s = 0; s < STATE_COUNT; s++) totals[s] = 0.0;
+    if (!snapshot) return;
+
+    for (int i = 0; i < snapshot->count; i++) {
+        const TaskInfo *task = &snapshot->tasks[i];
+        if (task->exited) continue;
+
+        /* Tasks too young to have a share are counted in their current state */
+        if (task->state_weight > 0.0f) {
+            for (int s = 0; s < STATE_COUNT; s++) totals[s] += task->state_share[s] / task->state_weight;
+        } else if (state_bucket(task->state) >= 0) {
+            totals[state_bucket(task->state)] += 1.0;
+        }
+    }
+}
+
+void compute_task_rates(Snapshot *snapshot, const Snapshot *prev) {
+    static long ticks_per_second = 0;
+    if (!ticks_per_second) ticks_per_second = sysconf(_SC_CLK_TCK);
+
+    if (!prev) return;
+
+    for (int i = 0; i < snapshot->count; i++) {
+        TaskInfo *task = &snapshot->tasks[i];
+        const TaskInfo *old = previous_sample(prev, task);
+        if (!old) continue;
+
+        /* A task that waited for its turn keeps the CPU% it was carried with */
+        uint64_t stat_ns = task->sampled_ns[SOURCE_STAT];
+        uint64_t old_stat_ns = old->sampled_ns[SOURCE_STAT];
+        if (task->cpu_ns && old->cpu_ns && task->cpu_ns_sampled > old->cpu_ns_sampled &&
+            task->cpu_ns >= old->cpu_ns) {
+            task->cpu_percent = (task->cpu_ns - old->cpu_ns) * 100.0 /
+                                (task->cpu_ns_sampled - old->cpu_ns_sampled);
+        } else if (stat_ns > old_stat_ns && task->cpu_ticks >= old->cpu_ticks) {
+            double stat_interval = (stat_ns - old_stat_ns) / 1e9;
+            task->cpu_percent = (task->cpu_ticks - old->cpu_ticks) * 100.0 /
+                                ticks_per_second / stat_interval;
+        }
+        if (stat_ns > old_stat_ns) account_state_time(task, old, stat_ns - old_stat_ns);
+
+        /* Carried I/O keeps its rate; a fresh read is measured against the
+         * previous read, however many ticks ago that was */
+        uint64_t io_ns = task->sampled_ns[SOURCE_IO];
+        uint64_t old_io_ns = old->sampled_ns[SOURCE_IO];
+        if ((task->collected & old->collected & FIELD_BIT(FIELD_IO_BYTES)) &&
+            io_ns > old_io_ns &&
+            task->io_read_bytes >= old->io_read_bytes &&
+            task->io_write_bytes >= old->io_write_bytes) {
+            double io_interval = (io_ns - old_io_ns) / 1e9;
+            task->io_read_rate = (task->io_read_bytes - old->io_read_bytes) / io_interval;
+            task->io_write_rate = (task->io_write_bytes - old->io_write_bytes) / io_interval;
+        }
+
+        /* Descriptors per hour, an exponential average over the reads of the
+         * fd directory; threads copied the leader's and come out the same */
+        uint64_t fd_ns = task->sampled_ns[SOURCE_FD];
+        uint64_t old_fd_ns = old->sampled_ns[SOURCE_FD];
+        if ((task->collected & old->collected & FIELD_BIT(FIELD_FDS)) && fd_ns > old_fd_ns) {
+            double fd_interval = (double)(fd_ns - old_fd_ns);
+            double keep = exp(-fd_interval / FD_RATE_WINDOW_NS);
+            double rate = (task->fd_count - old->fd_count) * 3600e9 / fd_interval;
+            task->fd_rate = old->fd_rate * keep + rate * (1.0 - keep);
+        }
+    }
+}
+
+int column_is_stale(const TaskInfo *task, ColumnId column, uint64_t taken_ns) {
+    for (int field = 0; field < FIELD_COUNT; field++) {
+        if ((columns[column].fields & FIELD_BIT(field)) &&
+            task->sampled_ns[field_source(field)] < taken_ns) return 1;
+    }
+    return 0;
+}
+
+const CollectStats* get_collect_stats(void) {
+    return &collect_stats;
+}
+
+void task_data_init(void) {
+    intern_init(&command_names);
+    intern_init(&wait_channels);
+    cmdline_cache_init(&cmdline_cache);
+    user_cache_init();
+}
+
+void task_data_cleanup(void) {
+    user_cache_cleanup();
+    cmdline_cache_free(&cmdline_cache);
+    intern_free(&wait_channels);
+    intern_free(&command_names);
+}
+
+void get_cmdline_cache_stats(CmdlineCacheStats *stats) {
+    stats->entries = cmdline_cache.count;
+    stats->hits = cmdline_cache.hits;
+    stats->misses = cmdline_cache.misses;
+    stats->evictions = cmdline_cache.evictions;
 }
 
 const char* get_state_string(char state) {
@@ -49,6 +1005,81 @@ const char* get_state_string(char state) {
         case 'D': return "Disk sleep";
         case 'Z': return "Zombie";
         case 'T': return "Stopped";
+        case 't': return "Traced";
+        case 'I': return "Idle";
+        case 'X': return "Dead";
         default: return "Unknown";
     }
 }
+
+void format_bytes(double bytes, char *buf, size_t size) {
+    const char *units = "BKMGTP";
+    int unit = 0;
+    while (bytes >= 1024.0 && units[unit + 1]) {
+        bytes /= 1024.0;
+        unit++;
+    }
+    if (unit == 0 || bytes >= 100.0) {
+        snprintf(buf, size, "%.0f%c", bytes, units[unit]);
+    } else {
+        snprintf(buf, size, "%.1f%c", bytes, units[unit]);
+    }
+}
+
+/* Signed, with no sign for what rounds to no change */
+static void format_growth(double value, char *buf, size_t size) {
+    if (fabs(value) < 0.5) {
+        snprintf(buf, size, "0");
+    } else {
+        snprintf(buf, size, "%+.0f", value);
+    }
+}
+
+/* Formatter for each kind of the column table (see COLUMN_TABLE) */
+#define FORMAT_INT(value, buf, size)       snprintf(buf, size, "%d", value)
+#define FORMAT_PERCENT(value, buf, size)   snprintf(buf, size, "%.1f", value)
+#define FORMAT_BYTES(value, buf, size)     format_bytes(value, buf, size)
+#define FORMAT_BYTE_RATE(value, buf, size) format_bytes(value, buf, size)
+#define FORMAT_GROWTH(value, buf, size)    format_growth(value, buf, size)
+#define FORMAT_USER(value, buf, size)      snprintf(buf, size, "%s", intern_lookup(&user_names, value))
+#define FORMAT_COMMAND(value, buf, size)   snprintf(buf, size, "%s", intern_lookup(&command_names, value))
+#define FORMAT_STATE(value, buf, size)     snprintf(buf, size, "%s", get_state_string(value))
+#define FORMAT_TEXT(value, buf, size)      snprintf(buf, size, "%s", value)
+#define FORMAT_WAIT(value, buf, size)      snprintf(buf, size, "%s", intern_lookup(&wait_channels, value))
+
+#define COLUMN_FORMATTER(id, name, title, width, right_align, sortable, group, field, visible, tier, kind, value) \
+    static void format_##id(const TaskInfo *task, char *buf, size_t size) { \
+        FORMAT_##kind(value, buf, size); \
+    }
+
+COLUMN_TABLE(COLUMN_FORMATTER)
+COLUMN_TABLE_TAIL(COLUMN_FORMATTER)
+
+typedef void (*Formatter)(const TaskInfo *task, char *buf, size_t size);
+
+#define COLUMN_FORMATTER_ENTRY(id, ...) [id] = format_##id,
+
+/* NULL for the plugin slots */
+static const Formatter formatters[COLUMN_COUNT] = {
+    COLUMN_TABLE(COLUMN_FORMATTER_ENTRY)
+    COLUMN_TABLE_TAIL(COLUMN_FORMATTER_ENTRY)
+};
+
+static void format_plugin(const TaskInfo *task, ColumnId column, char *buf, size_t size) {
+    PluginValue value = task->plugin_values[column - COL_PLUGIN_FIRST];
+    if (plugin_value_types[column - COL_PLUGIN_FIRST] == PLUGIN_NUMBER) {
+        snprintf(buf, size, "%g", value.number);
+    } else {
+        snprintf(buf, size, "%s", value.text ? value.text : "-");
+    }
+}
+
+void format_column(const TaskInfo *task, ColumnId column, char *buf, size_t size) {
+    if ((task->collected & columns[column].fields) != columns[column].fields) {
+        snprintf(buf, size, "-");
+    } else if (is_plugin_column(column)) {
+        format_plugin(task, column, buf, size);
+    } else {
+        formatters[column](task, buf, size);
+    }
+}
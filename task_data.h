@@ -1,26 +1,187 @@
 #ifndef TASK_DATA_H
 #define TASK_DATA_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
+#include "intmap.h"
+#include "columns.h"
+
 /* ========== Task Data Structures ========== */
 
-typedef struct {
+/* States time is accounted to; 'I' (idle kernel thread) counts as S, 'X' as Z and 't' as T */
+typedef enum {
+    STATE_RUNNING,
+    STATE_SLEEPING,
+    STATE_DISK,
+    STATE_ZOMBIE,
+    STATE_STOPPED,
+    STATE_COUNT
+} StateBucket;
+
+/* Time in state is an exponentially weighted average over about this long */
+#define STATE_WINDOW_NS (60ULL * 1000000000ULL)
+
+typedef struct TaskInfo {
     int pid;
     int tid;
+    unsigned uid;    /* Effective uid; the name comes from user_cache */
     char command[32];
     char state;  /* 'R' = Running, 'S' = Sleeping, 'D' = Disk sleep, 'Z' = Zombie, 'T' = Stopped */
+    unsigned char kernel_thread;  /* PF_KTHREAD in the stat flags */
+    unsigned char exited;         /* Gone from /proc, kept one more tick so the row can be shown
+                                     dying; not in the snapshot's tid index */
+    int command_id;  /* Interned command, see command_names */
+    unsigned long long starttime;  /* Clock ticks after boot; (pid, starttime) names a process */
+    uint64_t proc_ino;    /* Inode of the task's /proc entry; changes when the tid is reused */
+    const char *cmdline;  /* Full command line, in the snapshot's arena */
+    unsigned collected;   /* FIELD_BIT() mask of fields read for this task */
+    uint64_t sampled_ns[SOURCE_COUNT];  /* Monotonic time each source was read for this
+                                           task; older than the snapshot means carried
+                                           forward. Rates use these, not the snapshot's */
+
+    /* Raw counters */
+    unsigned long long cpu_ticks;       /* utime + stime, in clock ticks */
+    uint64_t cpu_ns;                    /* On-CPU time from schedstat; 0 = not read */
+    uint64_t cpu_ns_sampled;            /* When cpu_ns was read */
+    unsigned long long io_read_bytes;
+    unsigned long long io_write_bytes;
+
+    /* Memory, in bytes */
+    unsigned long long vm_size;
+    unsigned long long rss;
+
+    /* Rates against the previous snapshot */
+    double cpu_percent;
+    double io_read_rate;   /* bytes/s */
+    double io_write_rate;
+
+    /* Share of the window spent in each state, weighted towards the recent
+     * past; state_weight is how much of the window the task has been watched,
+     * so a young task's shares still add up to 100% */
+    float state_share[STATE_COUNT];
+    float state_weight;
+    unsigned state_changes;  /* State changes seen between two reads of stat */
+    int wchan_id;            /* Interned wait channel, see wait_channels */
+
+    /* Descriptors are the process's; threads show the leader's */
+    int fd_count;
+    int fd_limit;            /* Soft RLIMIT_NOFILE; 0 = unlimited or unknown */
+    double fd_rate;          /* Descriptors per hour, smoothed over FD_RATE_WINDOW_NS */
+
+    /* Filled by plugins once per snapshot, see plugin.h */
+    PluginValue plugin_values[MAX_PLUGIN_COLUMNS];
 } TaskInfo;
 
-#define MAX_TASKS 1000
+/* Per-collection counters for the debug panel */
+typedef struct {
+    int reads[SOURCE_COUNT];   /* Files read, by source */
+    int failed[SOURCE_COUNT];  /* Open/read failures, e.g. io without permission */
+    int carried[SOURCE_COUNT]; /* Not due this tick; copied from the previous snapshot */
+    int priority;              /* Tasks read because they are new or in the priority set */
+    int background;            /* Other tasks read within the budget or the sample */
+    int deferred;              /* Other tasks carried over whole, waiting for their turn */
+    int truncated;             /* Survival mode: the snapshot filled up, later tasks are missing */
+    int kernel_threads;        /* Kernel threads read this tick */
+    int kernel_reads_saved;    /* Files they would have needed read */
+    int schedstat_reads;       /* Priority tasks timed in nanoseconds */
+} CollectStats;
+
+/*
+ * Which tasks are read when a tick cannot afford to read them all. Tasks in
+ * the priority set, and new ones, are read every tick; the rest take turns,
+ * round-robin, within read_budget file reads per tick. In sampling mode the
+ * rest are instead a fresh random sample of sample_fraction of them.
+ */
+typedef struct {
+    const IntMap *priority;    /* tids on screen, selected or matching the filter */
+    const IntMap *wait_watch;  /* tids whose wait channel is read in any state; blocked ones always are */
+    int read_budget;           /* 0 = no limit */
+    double sample_fraction;    /* Below 1: sample instead of taking turns */
+    uint64_t tick_ns;          /* Nominal time between collections */
+} CollectSchedule;
+
+typedef struct {
+    int entries;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} CmdlineCacheStats;
+
+struct Snapshot;
+
+/* Interned command names; ranks are kept current by collect_task_data() */
+extern InternTable command_names;
+
+/* Interned wait channels (kernel symbols), read for blocked threads */
+extern InternTable wait_channels;
 
 /* ========== Task Data Functions ========== */
 
-/* Collect task data and populate the tasks array
- * TODO: Replace mock implementation with actual /proc parsing
- * Returns: number of tasks collected
+void task_data_init(void);
+void task_data_cleanup(void);
+
+/* Check if a string is all digits (e.g. a /proc entry name) */
+int is_numeric(char* str);
+
+/* Collect the fields in plan into an empty snapshot. Sources on a slower tier
+ * are only read on each task's slot, and tasks left out by the schedule not at
+ * all; otherwise prev's values are carried over.
+ * Returns: number of tasks collected, or -1 if the snapshot ran out of memory
+ */
+int collect_task_data(struct Snapshot *snapshot, const struct Snapshot *prev,
+                      const CollectPlan *plan, const CollectSchedule *schedule);
+
+/* Fill in CPU% and I/O rates from the previous snapshot's counters, each over
+ * the task's own interval between the two reads. CPU% is measured in
+ * nanoseconds where both snapshots read schedstat, in clock ticks otherwise.
+ * Time in state advances over the same interval between two stat reads, and
+ * descriptor growth between two reads of the fd directory
+ */
+void compute_task_rates(struct Snapshot *snapshot, const struct Snapshot *prev);
+
+/* Descriptor growth is averaged over about this long, so a burst of opens
+ * that are soon closed again does not look like a leak */
+#define FD_RATE_WINDOW_NS (10ULL * 60 * 1000000000ULL)
+
+/* Open descriptors as a percent of the soft limit; 0 if there is none */
+static inline double fd_limit_percent(const TaskInfo *task) {
+    return task->fd_limit > 0 ? 100.0 * task->fd_count / task->fd_limit : 0.0;
+}
+
+/* Percent of the window a task spent in a state */
+static inline double state_percent(const TaskInfo *task, StateBucket bucket) {
+    return task->state_weight > 0.0f ? 100.0 * task->state_share[bucket] / task->state_weight : 0.0;
+}
+
+/* Returns: the bucket of a stat state letter, or -1 for one that is not accounted */
+int state_bucket(char state);
+
+/* Threads in each state, averaged over the window, summed over live tasks */
+void state_totals(const struct Snapshot *snapshot, double totals[STATE_COUNT]);
+
+/* Returns: 1 if any value in the column was carried forward rather than read
+ * for this snapshot
+ */
+int column_is_stale(const TaskInfo *task, ColumnId column, uint64_t taken_ns);
+
+/* A thread's kernel stack as "innermost < caller < ...", which needs root
+ * Returns: -1 with errno set if it could not be read
  */
-int collect_task_data(TaskInfo *tasks, int max_tasks);
+int read_kernel_stack(int pid, int tid, char *buf, size_t size);
+
+/* Counters from the most recent collect_task_data() */
+const CollectStats* get_collect_stats(void);
+
+void get_cmdline_cache_stats(CmdlineCacheStats *stats);
 
 /* Get human-readable string for task state */
 const char* get_state_string(char state);
 
+/* Human-readable byte count, e.g. 512K, 12.3M */
+void format_bytes(double bytes, char *buf, size_t size);
+
+/* Format one column of a task for display; fields that were not collected show "-" */
+void format_column(const TaskInfo *task, ColumnId column, char *buf, size_t size);
+
 #endif /* TASK_DATA_H */
@@ -0,0 +1,336 @@
+#include "user_cache.h"
+#include "survival.h"
+#include "keymap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#define PASSWD_PATH "/etc/passwd"
+#define RESOLVER_QUEUE 64   /* uids handed to the resolver thread at a time */
+#define NAME_SIZE 64
+
+typedef enum {
+    USER_PASSWD,
+    USER_NSS,
+    USER_WAITING,   /* Resolver queue was full; submitted by a later poll */
+    USER_PENDING,   /* With the resolver */
+    USER_UNKNOWN
+} UserSource;
+
+typedef struct {
+    unsigned uid;
+    int name_id;
+    UserSource source;
+} UserEntry;
+
+InternTable user_names;
+
+static struct {
+    UserEntry *entries;
+    int count;
+    int capacity;
+    KeyMap index;        /* (uid, 0) -> entry */
+    int waiting;         /* Entries in USER_WAITING */
+    unsigned long reloads;
+} cache;
+
+static int unknown_name_id = -1;  /* "?", interned up front so it never fails */
+
+/* ========== Resolver Thread ========== */
+
+/*
+ * A ring of requests shared with the resolver thread. The counters only
+ * grow; a request's slot is its counter modulo RESOLVER_QUEUE. The UI thread
+ * submits and collects, the resolver resolves, and neither holds the lock
+ * across getpwuid_r().
+ */
+typedef struct {
+    unsigned uid;
+    int found;
+    char name[NAME_SIZE];
+} Request;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    Request requests[RESOLVER_QUEUE];
+    unsigned submitted;
+    unsigned resolved;
+    unsigned collected;
+    int running;
+    int stop;
+} resolver = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+static void* resolver_main(void *arg) {
+    (void)arg;
+    char buf[4096];
+
+    pthread_mutex_lock(&resolver.lock);
+    for (;;) {
+        while (resolver.resolved == resolver.submitted && !resolver.stop) {
+            pthread_cond_wait(&resolver.wake, &resolver.lock);
+        }
+        if (resolver.stop) break;
+        Request *request = &resolver.requests[resolver.resolved % RESOLVER_QUEUE];
+        unsigned uid = request->uid;
+        pthread_mutex_unlock(&resolver.lock);
+
+        /* This is the call that can block on NSS */
+        struct passwd pw;
+        struct passwd *result = NULL;
+        int found = getpwuid_r(uid, &pw, buf, sizeof(buf), &result) == 0 && result;
+
+        pthread_mutex_lock(&resolver.lock);
+        request->found = found;
+        if (found) snprintf(request->name, sizeof(request->name), "%s", pw.pw_name);
+        resolver.resolved++;
+    }
+    pthread_mutex_unlock(&resolver.lock);
+    return NULL;
+}
+
+/* Returns: 1 if uid was queued, 0 if the queue is full or there is no resolver */
+static int submit(unsigned uid) {
+    if (!resolver.running) return 0;
+
+    pthread_mutex_lock(&resolver.lock);
+    int queued = resolver.submitted - resolver.collected < RESOLVER_QUEUE;
+    if (queued) {
+        resolver.requests[resolver.submitted % RESOLVER_QUEUE].uid = uid;
+        resolver.submitted++;
+        pthread_cond_signal(&resolver.wake);
+    }
+    pthread_mutex_unlock(&resolver.lock);
+    return queued;
+}
+
+/* ========== Entries ========== */
+
+static int grow_entries(int new_capacity) {
+    if (heap_frozen) return -1;
+    UserEntry *entries = realloc(cache.entries, new_capacity * sizeof(UserEntry));
+    if (!entries) return -1;
+    cache.entries = entries;
+    cache.capacity = new_capacity;
+    return 0;
+}
+
+/* Returns: the entry for uid, or NULL */
+static UserEntry* find_entry(unsigned uid) {
+    int index = keymap_get(&cache.index, (int)uid, 0);
+    return index >= 0 ? &cache.entries[index] : NULL;
+}
+
+/* Returns: the new entry, or NULL if the cache could not grow */
+static UserEntry* add_entry(unsigned uid, int name_id, UserSource source) {
+    if (cache.count == cache.capacity &&
+        grow_entries(cache.capacity ? cache.capacity * 2 : 32) < 0) {
+        return NULL;
+    }
+    if (keymap_put(&cache.index, (int)uid, 0, cache.count) < 0) return NULL;
+
+    UserEntry *entry = &cache.entries[cache.count];
+    entry->uid = uid;
+    entry->name_id = name_id;
+    entry->source = source;
+    cache.count++;
+    return entry;
+}
+
+/* ========== /etc/passwd ========== */
+
+/* Lines are name:password:uid:...; NIS "+" and "-" lines are left to NSS */
+static void load_passwd(void) {
+    FILE *file = fopen(PASSWD_PATH, "r");
+    if (!file) return;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        char *name = line;
+        char *password = strchr(name, ':');
+        if (!password || name == password || name[0] == '+' || name[0] == '-') continue;
+        *password++ = '\0';
+        char *uid_field = strchr(password, ':');
+        if (!uid_field) continue;
+        uid_field++;
+
+        char *end;
+        unsigned long uid = strtoul(uid_field, &end, 10);
+        if (end == uid_field || *end != ':') continue;
+
+        /* The first line for a uid wins, as with getpwuid() */
+        if (find_entry(uid)) continue;
+        int name_id = intern_string(&user_names, name);
+        if (name_id < 0 || !add_entry(uid, name_id, USER_PASSWD)) break;
+    }
+    fclose(file);
+}
+
+#ifdef __linux__
+
+static int passwd_watch = -1;
+
+/* Watch the directory: passwd is usually replaced by rename(), not rewritten */
+static void watch_passwd(void) {
+    passwd_watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (passwd_watch < 0) return;
+    if (inotify_add_watch(passwd_watch, "/etc", IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(passwd_watch);
+        passwd_watch = -1;
+    }
+}
+
+/* Returns: 1 if passwd changed since the last call */
+static int passwd_changed(void) {
+    if (passwd_watch < 0) return 0;
+
+    uint64_t buf[512];  /* Aligned for the events */
+    int changed = 0;
+    ssize_t len;
+    while ((len = read(passwd_watch, buf, sizeof(buf))) > 0) {
+        for (char *p = (char*)buf; p < (char*)buf + len; ) {
+            struct inotify_event *event = (struct inotify_event*)p;
+            if (event->len && strcmp(event->name, "passwd") == 0) changed = 1;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+
+static void unwatch_passwd(void) {
+    if (passwd_watch >= 0) close(passwd_watch);
+    passwd_watch = -1;
+}
+
+#else /* !__linux__ */
+
+static void watch_passwd(void) {}
+static int passwd_changed(void) { return 0; }
+static void unwatch_passwd(void) {}
+
+#endif /* __linux__ */
+
+/* ========== Public Interface ========== */
+
+void user_cache_init(void) {
+    intern_init(&user_names);
+    unknown_name_id = intern_string(&user_names, "?");
+    load_passwd();
+    watch_passwd();
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, resolver_main, NULL) == 0) {
+        pthread_detach(thread);
+        resolver.running = 1;
+    }
+    intern_update_ranks(&user_names);
+}
+
+/* The resolver may be stuck in NSS, so it is told to stop but not joined */
+void user_cache_cleanup(void) {
+    if (resolver.running) {
+        pthread_mutex_lock(&resolver.lock);
+        resolver.stop = 1;
+        pthread_cond_signal(&resolver.wake);
+        pthread_mutex_unlock(&resolver.lock);
+        resolver.running = 0;
+    }
+    unwatch_passwd();
+
+    free(cache.entries);
+    keymap_free(&cache.index);
+    memset(&cache, 0, sizeof(cache));
+    intern_free(&user_names);
+}
+
+int user_cache_reserve(int users) {
+    if (keymap_reserve(&cache.index, users) < 0) return -1;
+    if (users > cache.capacity && grow_entries(users) < 0) return -1;
+    return intern_reserve(&user_names, users, 12);
+}
+
+void user_cache_poll(void) {
+    /* Take the answers, then intern them with the lock released */
+    Request answers[RESOLVER_QUEUE];
+    int count = 0;
+    pthread_mutex_lock(&resolver.lock);
+    while (resolver.collected != resolver.resolved) {
+        answers[count++] = resolver.requests[resolver.collected++ % RESOLVER_QUEUE];
+    }
+    pthread_mutex_unlock(&resolver.lock);
+
+    for (int i = 0; i < count; i++) {
+        /* Gone if passwd was reloaded while the uid was with the resolver */
+        UserEntry *entry = find_entry(answers[i].uid);
+        if (!entry || entry->source != USER_PENDING) continue;
+
+        int name_id = answers[i].found ? intern_string(&user_names, answers[i].name) : -1;
+        if (name_id >= 0) {
+            entry->name_id = name_id;
+            entry->source = USER_NSS;
+        } else {
+            entry->source = USER_UNKNOWN;
+        }
+    }
+
+    /* Reloading needs fopen(), which survival mode does not allow */
+    if (passwd_changed() && !heap_frozen) {
+        cache.count = 0;
+        cache.waiting = 0;
+        keymap_clear(&cache.index);
+        load_passwd();
+        cache.reloads++;
+    }
+
+    for (int i = 0; i < cache.count && cache.waiting > 0; i++) {
+        UserEntry *entry = &cache.entries[i];
+        if (entry->source != USER_WAITING) continue;
+        if (!submit(entry->uid)) break;
+        entry->source = USER_PENDING;
+        cache.waiting--;
+    }
+}
+
+int user_name_id(unsigned uid) {
+    UserEntry *entry = find_entry(uid);
+    if (entry) return entry->name_id;
+
+    /* Shown as a number until the resolver has an answer */
+    char number[16];
+    snprintf(number, sizeof(number), "%u", uid);
+    int name_id = intern_string(&user_names, number);
+    if (name_id < 0) return unknown_name_id;
+
+    entry = add_entry(uid, name_id, USER_UNKNOWN);
+    if (!entry || heap_frozen) return name_id;
+    if (submit(uid)) {
+        entry->source = USER_PENDING;
+    } else if (resolver.running) {
+        entry->source = USER_WAITING;
+        cache.waiting++;
+    }
+    return name_id;
+}
+
+void user_cache_get_stats(UserCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->entries = cache.count;
+    stats->reloads = cache.reloads;
+    for (int i = 0; i < cache.count; i++) {
+        switch (cache.entries[i].source) {
+            case USER_PASSWD:  stats->from_passwd++; break;
+            case USER_NSS:     stats->from_nss++; break;
+            case USER_WAITING:
+            case USER_PENDING: stats->pending++; break;
+            case USER_UNKNOWN: stats->unknown++; break;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef USER_CACHE_H
+#define USER_CACHE_H
+
+#include "intern.h"
+
+/* ========== User Name Cache ========== */
+
+/*
+ * uid -> user name without calling getpwuid() on the UI thread, where NSS
+ * can block for seconds on LDAP. /etc/passwd is parsed once into the cache
+ * and again whenever inotify reports it was rewritten. A uid not in it is
+ * shown as its number and handed to a resolver thread; the name replaces the
+ * number once the thread has an answer. Names are interned, so user columns
+ * sort by rank and aggregate by id like commands do.
+ */
+
+/* Interned user names; ranks are kept current by collect_task_data() */
+extern InternTable user_names;
+
+typedef struct {
+    int entries;
+    int from_passwd;
+    int from_nss;          /* Answered by the resolver thread */
+    int pending;           /* Waiting for the resolver */
+    int unknown;           /* Neither knows the uid; shown as a number */
+    unsigned long reloads; /* /etc/passwd changed and was parsed again */
+} UserCacheStats;
+
+void user_cache_init(void);
+void user_cache_cleanup(void);
+
+/* Room for this many users without growing. Returns: -1 on allocation failure */
+int user_cache_reserve(int users);
+
+/*
+ * Pick up the resolver's answers and reload /etc/passwd if it changed. Call
+ * once per refresh, before the snapshot's uids are looked up. Never blocks.
+ */
+void user_cache_poll(void);
+
+/* Returns: the interned name of uid, its number while it is being resolved;
+ * "?" if the cache is full. Never blocks
+ */
+int user_name_id(unsigned uid);
+
+void user_cache_get_stats(UserCacheStats *stats);
+
+#endif /* USER_CACHE_H */